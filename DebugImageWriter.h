@@ -0,0 +1,76 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef DEBUGIMAGEWRITER_H
+#define DEBUGIMAGEWRITER_H
+
+// ITK
+#include "itkConditionVariable.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkProcessObject.h"
+
+// STL
+#include <deque>
+#include <string>
+
+// Writes intermediate images on a background thread so that the filter calling Write() never waits on the disk.
+// The thread is started by the first Write(); the destructor waits until everything queued has been written.
+class DebugImageWriter
+{
+public:
+  DebugImageWriter();
+  ~DebugImageWriter();
+
+  // Queue a copy of 'image' to be written to directory/fileName.
+  template<typename TImage>
+  void Write(const TImage* image, const std::string& directory, const std::string& fileName);
+
+  // Block until every queued image has been written.
+  void Flush();
+
+private:
+  DebugImageWriter(const DebugImageWriter&); //purposely not implemented
+  void operator=(const DebugImageWriter&); //purposely not implemented
+
+  void Enqueue(itk::ProcessObject* writer);
+
+  static ITK_THREAD_RETURN_TYPE ThreadFunction(void* arg);
+  void ProcessQueue();
+
+  // Writers that are set up and waiting for the thread to Update() them.
+  std::deque<itk::ProcessObject::Pointer> Queue;
+
+  // Number of queued images that have not been written yet (including the one being written).
+  unsigned int NumberOfPendingWrites;
+
+  // Guards Queue, NumberOfPendingWrites and StopThread.
+  itk::SimpleMutexLock Mutex;
+
+  // Signaled whenever the queue or NumberOfPendingWrites changes.
+  itk::ConditionVariable::Pointer QueueChanged;
+
+  itk::MultiThreader::Pointer Threader;
+  itk::ThreadIdType ThreadId;
+  bool ThreadStarted;
+  bool StopThread;
+};
+
+#include "DebugImageWriter.hxx"
+
+#endif
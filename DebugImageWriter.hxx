@@ -0,0 +1,125 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// ITK
+#include "itkImageDuplicator.h"
+#include "itkImageFileWriter.h"
+
+inline DebugImageWriter::DebugImageWriter() : NumberOfPendingWrites(0), ThreadId(0), ThreadStarted(false), StopThread(false)
+{
+  this->QueueChanged = itk::ConditionVariable::New();
+  this->Threader = itk::MultiThreader::New();
+}
+
+inline DebugImageWriter::~DebugImageWriter()
+{
+  if(!this->ThreadStarted)
+    {
+    return;
+    }
+
+  // The thread drains the queue before it honors the stop request.
+  this->Mutex.Lock();
+  this->StopThread = true;
+  this->QueueChanged->Broadcast();
+  this->Mutex.Unlock();
+
+  this->Threader->TerminateThread(this->ThreadId);
+}
+
+template<typename TImage>
+void DebugImageWriter::Write(const TImage* image, const std::string& directory, const std::string& fileName)
+{
+  // The caller may modify the image as soon as we return, so the thread writes a copy.
+  typedef itk::ImageDuplicator<TImage> DuplicatorType;
+  typename DuplicatorType::Pointer duplicator = DuplicatorType::New();
+  duplicator->SetInputImage(image);
+  duplicator->Update();
+
+  typename itk::ImageFileWriter<TImage>::Pointer writer = itk::ImageFileWriter<TImage>::New();
+  writer->SetFileName(directory + "/" + fileName);
+  writer->SetInput(duplicator->GetOutput());
+
+  Enqueue(writer);
+}
+
+inline void DebugImageWriter::Flush()
+{
+  this->Mutex.Lock();
+  while(this->NumberOfPendingWrites > 0)
+    {
+    this->QueueChanged->Wait(&this->Mutex);
+    }
+  this->Mutex.Unlock();
+}
+
+inline void DebugImageWriter::Enqueue(itk::ProcessObject* writer)
+{
+  this->Mutex.Lock();
+  this->Queue.push_back(writer);
+  this->NumberOfPendingWrites++;
+  this->QueueChanged->Broadcast();
+  this->Mutex.Unlock();
+
+  if(!this->ThreadStarted)
+    {
+    this->ThreadId = this->Threader->SpawnThread(ThreadFunction, this);
+    this->ThreadStarted = true;
+    }
+}
+
+inline ITK_THREAD_RETURN_TYPE DebugImageWriter::ThreadFunction(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  static_cast<DebugImageWriter*>(threadInfo->UserData)->ProcessQueue();
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+inline void DebugImageWriter::ProcessQueue()
+{
+  while(true)
+    {
+    this->Mutex.Lock();
+    while(this->Queue.empty() && !this->StopThread)
+      {
+      this->QueueChanged->Wait(&this->Mutex);
+      }
+    if(this->Queue.empty())
+      {
+      this->Mutex.Unlock();
+      return;
+      }
+    itk::ProcessObject::Pointer writer = this->Queue.front();
+    this->Queue.pop_front();
+    this->Mutex.Unlock();
+
+    try
+      {
+      writer->Update();
+      }
+    catch(itk::ExceptionObject& error)
+      {
+      std::cerr << "Could not write debug image: " << error << std::endl;
+      }
+
+    this->Mutex.Lock();
+    this->NumberOfPendingWrites--;
+    this->QueueChanged->Broadcast();
+    this->Mutex.Unlock();
+    }
+}
@@ -175,6 +175,20 @@ void SuperPixelSegmentationGUI::on_btnSegmentQuickShift_clicked()
   QuickShiftThread->start();
 }
 
+void SuperPixelSegmentationGUI::on_sldMaxDist_valueChanged(float value)
+{
+  // Lowering MaxDist only cuts the forest of the last quick shift run, so show the result right away.
+  // Larger values (or no run yet) need the Segment button.
+  if(this->QuickShiftThread->isRunning())
+    {
+    return;
+    }
+  if(this->QuickShiftFilter->CutForest(value))
+    {
+    slot_QuickShiftComplete();
+    }
+}
+
 void SuperPixelSegmentationGUI::on_btnSegmentSLIC_clicked()
 {
   this->SLICFilter->SetSpatialDistanceWeight(this->sldSLICSpatialDistanceWeight->GetValue());
@@ -210,6 +224,12 @@ void SuperPixelSegmentationGUI::OpenImage(const std::string& imageFileName)
 
   Helpers::DeepCopy<ImageType>(imageReader->GetOutput(), this->Image);
 
+  // The quick shift forest of the previous image cannot be cut for this one.
+  if(!this->QuickShiftThread->isRunning())
+    {
+    this->QuickShiftFilter->ReleaseWorkspace();
+    }
+
   QImage qimageImage = HelpersQt::GetQImageRGBA<ImageType>(this->Image);
   this->InputImagePixmapItem = this->Scene->addPixmap(QPixmap::fromImage(qimageImage));
   this->graphicsView->fitInView(this->InputImagePixmapItem);
@@ -55,6 +55,8 @@ public slots:
   void on_btnSegmentGraphCut_clicked();
   void on_btnSegmentSLIC_clicked();
   void on_btnSegmentQuickShift_clicked();
+
+  void on_sldMaxDist_valueChanged(float value);
   
   void on_chkShowInputImage_clicked();
   void on_chkShowColoredImage_clicked();
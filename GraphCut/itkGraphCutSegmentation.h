@@ -3,6 +3,16 @@
 #define __itkGraphCutSegmentation_h
 
 #include "itkImageToImageFilter.h"
+#include "itkSimpleDataObjectDecorator.h"
+
+// Custom
+#include "DebugImageWriter.h"
+#include "RegionStatistics.h"
+
+// Segmentation
+#include "image.h" // The image class for the segmentation algorithm
+#include "misc.h" // Defines the 'rgb' type.
+#include "segment-workspace.h"
 
 namespace itk
 {
@@ -15,6 +25,9 @@ public:
   typedef ImageToImageFilter<TInputImage, TOutputLabelImage> Superclass;
   typedef SmartPointer< Self >        Pointer;
 
+  /** The output holding the statistics of each superpixel. */
+  typedef SimpleDataObjectDecorator< ::RegionStatistics > RegionStatisticsObjectType;
+
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
 
@@ -36,15 +49,35 @@ public:
   // Blur the image before computing the super pixels.
   itkSetMacro( BlurFirst, bool);
   itkGetMacro( BlurFirst, bool);
+
+  // The statistics of each superpixel to compute into GetRegionStatistics(), as an or of RegionStatistics::Statistic.
+  // 0 (the default) computes none. The histogram settings of the RegionStatistics of the output are kept.
+  itkSetMacro( Statistics, unsigned int);
+  itkGetMacro( Statistics, unsigned int);
+
+  // Write intermediate images to DebugDirectory on a background thread. Off by default.
+  itkSetMacro( WriteDebugImages, bool);
+  itkGetMacro( WriteDebugImages, bool);
+
+  // Directory the debug images are written to.
+  itkSetStringMacro( DebugDirectory );
+  itkGetStringMacro( DebugDirectory );
   
   TOutputLabelImage* GetLabelImage();
   TInputImage* GetColoredImage();
+  RegionStatisticsObjectType* GetRegionStatistics();
   
   unsigned int FinalNumberOfSegments;
+
+  // Free the scratch buffers that are kept between updates.
+  void ReleaseWorkspace();
   
 protected:
   GraphCutSegmentation();
-  ~GraphCutSegmentation(){}
+  ~GraphCutSegmentation()
+  {
+    ReleaseWorkspace();
+  }
 
   /** Does the real work. */
   virtual void GenerateData();
@@ -60,6 +93,22 @@ private:
   float m_Sigma;
   
   bool m_BlurFirst;
+
+  unsigned int m_Statistics;
+
+  bool m_WriteDebugImages;
+  std::string m_DebugDirectory;
+  DebugImageWriter m_DebugImageWriter;
+
+  // Scratch buffers that are reused by every update on same-sized inputs.
+  struct Workspace
+  {
+    Workspace() : Input(NULL), Segments(NULL) {}
+    image<rgb>* Input; // The input in the form the segmentation algorithm expects
+    image<int>* Segments; // The component id of every pixel
+    segment_workspace Segmentation; // Color planes and graph edges
+  };
+  Workspace m_Workspace;
 };
 } //namespace ITK
 
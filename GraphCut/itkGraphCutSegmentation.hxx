@@ -23,12 +23,13 @@ namespace itk
 
 template< typename TInputImage, typename TOutputLabelImage>
 GraphCutSegmentation< TInputImage, TOutputLabelImage>
-::GraphCutSegmentation() : m_MinSize(20), m_K(500), m_Sigma(2.0)
+::GraphCutSegmentation() : m_MinSize(20), m_K(500), m_Sigma(2.0), m_Statistics(0), m_WriteDebugImages(false), m_DebugDirectory(".")
 {
-  this->SetNumberOfRequiredOutputs(2);
+  this->SetNumberOfRequiredOutputs(3);
 
   this->SetNthOutput( 0, this->MakeOutput(0) );
   this->SetNthOutput( 1, this->MakeOutput(1) );
+  this->SetNthOutput( 2, this->MakeOutput(2) );
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
@@ -44,6 +45,9 @@ DataObject::Pointer GraphCutSegmentation<TInputImage, TOutputLabelImage>::MakeOu
     case 1:
       output = ( TInputImage::New() ).GetPointer(); // The output for the image colored by the average color in each region
       break;
+    case 2:
+      output = ( RegionStatisticsObjectType::New() ).GetPointer(); // The output for the statistics of each region
+      break;
     default:
       std::cerr << "No output " << idx << std::endl;
       output = NULL;
@@ -64,6 +68,24 @@ TInputImage* GraphCutSegmentation<TInputImage, TOutputLabelImage>::GetColoredIma
   return dynamic_cast< TInputImage * >(this->ProcessObject::GetOutput(1) );
 }
 
+template< typename TInputImage, typename TOutputLabelImage>
+typename GraphCutSegmentation<TInputImage, TOutputLabelImage>::RegionStatisticsObjectType*
+GraphCutSegmentation<TInputImage, TOutputLabelImage>::GetRegionStatistics()
+{
+  return dynamic_cast< RegionStatisticsObjectType * >(this->ProcessObject::GetOutput(2) );
+}
+
+template< typename TInputImage, typename TOutputLabelImage>
+void GraphCutSegmentation< TInputImage, TOutputLabelImage>
+::ReleaseWorkspace()
+{
+  delete this->m_Workspace.Input;
+  this->m_Workspace.Input = NULL;
+  delete this->m_Workspace.Segments;
+  this->m_Workspace.Segments = NULL;
+  this->m_Workspace.Segmentation.release();
+}
+
 template< typename TInputImage, typename TOutputLabelImage>
 void GraphCutSegmentation< TInputImage, TOutputLabelImage>
 ::GenerateData()
@@ -92,13 +114,24 @@ void GraphCutSegmentation< TInputImage, TOutputLabelImage>
 
     }
 
-  Helpers::WriteImage<TInputImage>(input, "finalInput.mha");
+  if(this->m_WriteDebugImages)
+    {
+    this->m_DebugImageWriter.Write<TInputImage>(input, this->m_DebugDirectory, "finalInput.mha");
+    }
 
   itk::Size<2> size = input->GetLargestPossibleRegion().GetSize();
   //std::cout << "Size: " << size << std::endl;
   unsigned int width = size[0];
   unsigned int height = size[1];
-  image<rgb> *im = new image<rgb>(width, height);
+
+  if(!this->m_Workspace.Input || this->m_Workspace.Input->width() != static_cast<int>(width) ||
+     this->m_Workspace.Input->height() != static_cast<int>(height))
+    {
+    ReleaseWorkspace();
+    this->m_Workspace.Input = new image<rgb>(width, height, false);
+    this->m_Workspace.Segments = new image<int>(width, height, false);
+    }
+  image<rgb> *im = this->m_Workspace.Input;
 
   itk::ImageRegionConstIterator<TInputImage> imageIterator(input, input->GetLargestPossibleRegion());
 
@@ -117,7 +150,8 @@ void GraphCutSegmentation< TInputImage, TOutputLabelImage>
     }
 
   int numberOfSegments;
-  image<int> *segmentImage = segment_image(im, this->m_K, this->m_MinSize, &numberOfSegments);
+  image<int> *segmentImage = this->m_Workspace.Segments;
+  segment_image(im, this->m_K, this->m_MinSize, &numberOfSegments, segmentImage, &this->m_Workspace.Segmentation);
 
   std::cout << "There were " << numberOfSegments << " segments." << std::endl;
   this->FinalNumberOfSegments = numberOfSegments;
@@ -137,9 +171,20 @@ void GraphCutSegmentation< TInputImage, TOutputLabelImage>
     ++outputIterator;
     }
 
-  Helpers::RelabelSequential<TOutputLabelImage>(outputLabelImage, outputLabelImage);
+  const unsigned int numberOfLabels = Helpers::RelabelSequential<TOutputLabelImage>(outputLabelImage, outputLabelImage);
     
-  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(input, this->GetLabelImage(), this->GetColoredImage());
+  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(input, this->GetLabelImage(), this->GetColoredImage(), numberOfLabels);
+
+  // The statistics, or an empty table so that none of a previous update is left.
+  if(this->m_Statistics)
+    {
+    this->GetRegionStatistics()->Get().Compute(input.GetPointer(), this->GetLabelImage(), this->m_Statistics, numberOfLabels);
+    }
+  else
+    {
+    this->GetRegionStatistics()->Get().Clear();
+    }
+  this->GetRegionStatistics()->Modified();
 }
 
 }// end namespace
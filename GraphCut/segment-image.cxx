@@ -1,4 +1,5 @@
 #include "segment-image.h"
+#include "segment-workspace.h"
 
 rgb random_rgb()
 { 
@@ -13,12 +14,21 @@ rgb random_rgb()
 }
 
 image<int> *segment_image(image<rgb> *im, float c, int min_size, int *num_ccs) {
+  segment_workspace workspace;
+  image<int> *output = new image<int>(im->width(), im->height(), false);
+  segment_image(im, c, min_size, num_ccs, output, &workspace);
+  return output;
+}
+
+void segment_image(image<rgb> *im, float c, int min_size, int *num_ccs,
+                   image<int> *output, segment_workspace *workspace) {
   int width = im->width();
   int height = im->height();
 
-  image<float> *r = new image<float>(width, height);
-  image<float> *g = new image<float>(width, height);
-  image<float> *b = new image<float>(width, height);
+  workspace->reserve(width, height);
+  image<float> *r = workspace->r;
+  image<float> *g = workspace->g;
+  image<float> *b = workspace->b;
  
   // Copy the input image into the separate channel images
   for (int y = 0; y < height; y++) {
@@ -30,7 +40,7 @@ image<int> *segment_image(image<rgb> *im, float c, int min_size, int *num_ccs) {
   }
 
   // build graph
-  edge *edges = new edge[width*height*4];
+  edge *edges = workspace->edges;
   int num = 0;
   for (int y = 0; y < height; y++) {
     for (int x = 0; x < width; x++) {
@@ -64,11 +74,6 @@ image<int> *segment_image(image<rgb> *im, float c, int min_size, int *num_ccs) {
     }
   }
 
-  delete r;
-  delete g;
-  delete b;
-
-
   // segment
   universe *u = segment_graph(width*height, num, edges, c);
   
@@ -79,11 +84,8 @@ image<int> *segment_image(image<rgb> *im, float c, int min_size, int *num_ccs) {
     if ((a != b) && ((u->size(a) < min_size) || (u->size(b) < min_size)))
       u->join(a, b);
   }
-  delete [] edges;
   *num_ccs = u->num_sets();
 
-  image<int> *output = new image<int>(width, height);
-
   for (int y = 0; y < height; y++) {
     for (int x = 0; x < width; x++) {
       int comp = u->find(y * width + x);
@@ -91,10 +93,7 @@ image<int> *segment_image(image<rgb> *im, float c, int min_size, int *num_ccs) {
     }
   }  
 
-  //delete [] colors;  
   delete u;
-
-  return output;
 }
 
 
@@ -0,0 +1,80 @@
+/*
+Copyright (C) 2006 Pedro Felzenszwalb
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+/* scratch buffers for segment_image that can be kept between calls */
+
+#ifndef SEGMENT_WORKSPACE_H
+#define SEGMENT_WORKSPACE_H
+
+#include "image.h"
+#include "misc.h"
+#include "segment-graph.h"
+
+class segment_workspace {
+ public:
+  segment_workspace() : r(NULL), g(NULL), b(NULL), edges(NULL), w(0), h(0) {}
+
+  ~segment_workspace() { release(); }
+
+  /* make sure the buffers fit a width x height image */
+  void reserve(const int width, const int height) {
+    if (width == w && height == h)
+      return;
+    release();
+    r = new image<float>(width, height, false);
+    g = new image<float>(width, height, false);
+    b = new image<float>(width, height, false);
+    edges = new edge[width*height*4];
+    w = width;
+    h = height;
+  }
+
+  /* free all buffers */
+  void release() {
+    delete r;
+    delete g;
+    delete b;
+    delete [] edges;
+    r = g = b = NULL;
+    edges = NULL;
+    w = h = 0;
+  }
+
+  /* color planes of the input image */
+  image<float> *r, *g, *b;
+
+  /* graph edges (at most 4 per pixel) */
+  edge *edges;
+
+ private:
+  segment_workspace(const segment_workspace &);
+  void operator=(const segment_workspace &);
+
+  int w, h;
+};
+
+/*
+ * Same as segment_image(), but the labels are written to the caller
+ * provided output image and the scratch buffers are taken from
+ * workspace, so repeated calls on same-sized images do not allocate
+ * them again.
+ */
+void segment_image(image<rgb> *im, float c, int min_size, int *num_ccs,
+                   image<int> *output, segment_workspace *workspace);
+
+#endif
@@ -25,8 +25,10 @@
 namespace Helpers
 {
 
+// Color each pixel with the average color of its label. The labels are 0 to numberOfLabels - 1, e.g. as counted by
+// RelabelSequential(); 0 finds the count from the largest label.
 template <typename TImage, typename TLabelImage>
-void ColorLabelsByAverageColor(const TImage* image, const TLabelImage* labelImage, TImage* output);
+void ColorLabelsByAverageColor(const TImage* image, const TLabelImage* labelImage, TImage* output, unsigned int numberOfLabels = 0);
 
 template <typename TImage>
 typename TImage::PixelType MaxValue(const TImage* image);
@@ -55,8 +57,10 @@ void DeepCopyInRegion(const TImage* input, const itk::ImageRegion<2>& region, TI
 template<>
 void DeepCopy<itk::VectorImage<unsigned char, 2> >(const itk::VectorImage<unsigned char, 2>* input, itk::VectorImage<unsigned char, 2>* output);
 
+// Renumber the labels 0, 1, 2, ... in the order of the old labels (orderByOldLabel) or in the order they first appear
+// in the image. The input may be the output. Returns the number of labels.
 template<typename TImage>
-void RelabelSequential(typename TImage::Pointer input, typename TImage::Pointer output);
+unsigned int RelabelSequential(typename TImage::Pointer input, typename TImage::Pointer output, const bool orderByOldLabel = true);
 
 template<typename TVectorImage>
 void BilateralFilterAllChannels(const TVectorImage* image, TVectorImage* output, const float domainSigma, const float rangeSigma);
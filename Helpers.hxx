@@ -23,9 +23,13 @@
 #include "itkVectorIndexSelectionCastImageFilter.h"
 #include "itkComposeImageFilter.h"
 #include "itkBilateralImageFilter.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
 
 // STL
-#include <set>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 
 namespace Helpers
 {
@@ -36,9 +40,110 @@ void DeepCopy(const TImage* input, TImage* output)
   DeepCopyInRegion<TImage>(input, input->GetLargestPossibleRegion(), output);
 }
 
+// How the pixels of an image type lie in its buffer, for the buffer-level fast paths of DeepCopyInRegion() and
+// WriteRGBImage(). Image types not listed here only have the iterator versions.
+template<typename TImage>
+struct ImageBufferTraits
+{
+  static const bool IsContiguous = false;
+};
+
+// One pixel per element of the buffer.
+template<typename TPixel, unsigned int VDimension>
+struct ImageBufferTraits<itk::Image<TPixel, VDimension> >
+{
+  static const bool IsContiguous = true;
+  typedef itk::Image<TPixel, VDimension> ImageType;
+  typedef TPixel ValueType; // of the buffer
+  typedef typename itk::NumericTraits<TPixel>::ValueType ComponentType;
+
+  static void SetValuesPerPixel(const ImageType*, ImageType*) {}
+
+  static std::size_t GetValuesPerPixel(const ImageType*)
+  {
+    return 1;
+  }
+
+  static ComponentType GetComponent(const ValueType* buffer, const std::size_t pixel, const unsigned int component,
+                                    const std::size_t)
+  {
+    return buffer[pixel][component];
+  }
+};
+
+// The components of each pixel one after the other.
+template<typename TValue, unsigned int VDimension>
+struct ImageBufferTraits<itk::VectorImage<TValue, VDimension> >
+{
+  static const bool IsContiguous = true;
+  typedef itk::VectorImage<TValue, VDimension> ImageType;
+  typedef TValue ValueType; // of the buffer
+  typedef TValue ComponentType;
+
+  static void SetValuesPerPixel(const ImageType* input, ImageType* output)
+  {
+    output->SetNumberOfComponentsPerPixel(input->GetNumberOfComponentsPerPixel());
+  }
+
+  static std::size_t GetValuesPerPixel(const ImageType* image)
+  {
+    return image->GetNumberOfComponentsPerPixel();
+  }
+
+  static ComponentType GetComponent(const ValueType* buffer, const std::size_t pixel, const unsigned int component,
+                                    const std::size_t valuesPerPixel)
+  {
+    return buffer[pixel * valuesPerPixel + component];
+  }
+};
+
+// Whether the buffer of 'image' holds exactly 'region', i.e. a copy of the region is a copy of the buffer.
+template<typename TImage>
+bool IsWholeBuffer(const TImage* image, const itk::ImageRegion<2>& region)
+{
+  return region == image->GetLargestPossibleRegion() && image->GetBufferedRegion() == region;
+}
+
+// The buffer-level copy of DeepCopyInRegion(), for the image types whose buffers are contiguous. Returns false, and
+// leaves 'output' alone, if the region is not the whole buffer.
+template<typename TImage, bool VContiguous = ImageBufferTraits<TImage>::IsContiguous>
+struct BufferCopy
+{
+  static bool Copy(const TImage*, const itk::ImageRegion<2>&, TImage*)
+  {
+    return false;
+  }
+};
+
+template<typename TImage>
+struct BufferCopy<TImage, true>
+{
+  static bool Copy(const TImage* input, const itk::ImageRegion<2>& region, TImage* output)
+  {
+    typedef ImageBufferTraits<TImage> Traits;
+    if(!IsWholeBuffer(input, region))
+      {
+      return false;
+      }
+    Traits::SetValuesPerPixel(input, output);
+    output->SetRegions(region);
+    output->Allocate();
+
+    // std::copy is a memmove for the plain pixel types.
+    const std::size_t size = region.GetNumberOfPixels() * Traits::GetValuesPerPixel(input);
+    std::copy(input->GetBufferPointer(), input->GetBufferPointer() + size, output->GetBufferPointer());
+    return true;
+  }
+};
+
 template<typename TImage>
 void DeepCopyInRegion(const TImage* input, const itk::ImageRegion<2>& region, TImage* output)
 {
+  if(BufferCopy<TImage>::Copy(input, region, output))
+    {
+    return;
+    }
+
   output->SetRegions(region);
   output->Allocate();
 
@@ -90,6 +195,60 @@ void WriteImage(const TImage* image, const std::string& filename)
 }
 
 
+// The first three channels of each pixel of 'input' as unsigned chars, from the buffer for the image types whose
+// buffers are contiguous, or else with iterators.
+template<typename TImage, bool VContiguous = ImageBufferTraits<TImage>::IsContiguous>
+struct RGBPack
+{
+  typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> RGBImageType;
+
+  static void Pack(const TImage* input, RGBImageType* output)
+  {
+    itk::ImageRegionConstIterator<TImage> inputIterator(input, input->GetLargestPossibleRegion());
+    itk::ImageRegionIterator<RGBImageType> outputIterator(output, output->GetLargestPossibleRegion());
+
+    while(!inputIterator.IsAtEnd())
+      {
+      itk::CovariantVector<unsigned char, 3> pixel;
+      for(unsigned int i = 0; i < 3; ++i)
+        {
+        pixel[i] = inputIterator.Get()[i];
+        }
+      outputIterator.Set(pixel);
+      ++inputIterator;
+      ++outputIterator;
+      }
+  }
+};
+
+template<typename TImage>
+struct RGBPack<TImage, true>
+{
+  typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> RGBImageType;
+
+  static void Pack(const TImage* input, RGBImageType* output)
+  {
+    typedef ImageBufferTraits<TImage> Traits;
+    if(!IsWholeBuffer(input, input->GetLargestPossibleRegion()))
+      {
+      RGBPack<TImage, false>::Pack(input, output);
+      return;
+      }
+
+    const typename Traits::ValueType* buffer = input->GetBufferPointer();
+    const std::size_t valuesPerPixel = Traits::GetValuesPerPixel(input);
+    const std::size_t numberOfPixels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+    RGBImageType::PixelType* rgb = output->GetBufferPointer();
+    for(std::size_t pixel = 0; pixel < numberOfPixels; ++pixel)
+      {
+      for(unsigned int i = 0; i < 3; ++i)
+        {
+        rgb[pixel][i] = Traits::GetComponent(buffer, pixel, i, valuesPerPixel);
+        }
+      }
+  }
+};
+
 template<typename TImage>
 void WriteRGBImage(const TImage* input, const std::string& filename)
 {
@@ -99,20 +258,7 @@ void WriteRGBImage(const TImage* input, const std::string& filename)
   output->SetRegions(input->GetLargestPossibleRegion());
   output->Allocate();
 
-  itk::ImageRegionConstIterator<TImage> inputIterator(input, input->GetLargestPossibleRegion());
-  itk::ImageRegionIterator<RGBImageType> outputIterator(output, output->GetLargestPossibleRegion());
-
-  while(!inputIterator.IsAtEnd())
-    {
-    itk::CovariantVector<unsigned char, 3> pixel;
-    for(unsigned int i = 0; i < 3; ++i)
-      {
-      pixel[i] = inputIterator.Get()[i];
-      }
-    outputIterator.Set(pixel);
-    ++inputIterator;
-    ++outputIterator;
-    }
+  RGBPack<TImage>::Pack(input, output);
 
   typename itk::ImageFileWriter<RGBImageType>::Pointer writer = itk::ImageFileWriter<RGBImageType>::New();
   writer->SetFileName(filename);
@@ -141,46 +287,256 @@ void WriteRegion(const typename TImage::Pointer image, const itk::ImageRegion<2>
   writer->Update();
 }
 
-template<typename TImage>
-void RelabelSequential(typename TImage::Pointer input, typename TImage::Pointer output)
+// State shared by the threads of RelabelSequential(). The image is split into one run of consecutive pixels per thread.
+template<typename TLabel>
+struct RelabelSequentialData
 {
-  output->SetRegions(input->GetLargestPossibleRegion());
-  output->Allocate();
+  const TLabel* Input;
+  TLabel* Output;
+  std::size_t NumberOfPixels;
+  unsigned int NumberOfRuns;
+  bool OrderByOldLabel;
+
+  // 0: range of the labels, 1: labels seen by each run, 2: new labels.
+  unsigned int Pass;
+
+  // Smallest and largest label of each run.
+  std::vector<TLabel> RunMinimum;
+  std::vector<TLabel> RunMaximum;
+
+  // Labels within a range not much larger than the image are looked up directly (Dense), others by binary search in
+  // SortedLabels.
+  bool Dense;
+  TLabel MinimumLabel;
+  std::vector<TLabel> SortedLabels;
+
+  // The labels seen by each run: a flag per label of its range (dense) or its sorted labels (sparse), and for
+  // first-seen order the labels in the order the run first saw them.
+  std::vector<std::vector<bool> > RunSeen;
+  std::vector<std::vector<TLabel> > RunLabels;
+  std::vector<std::vector<TLabel> > RunFirstSeen;
+
+  // New label of each label, by slot (see Slot()).
+  std::vector<TLabel> NewLabels;
+
+  void GetRun(const unsigned int run, std::size_t& begin, std::size_t& end) const
+  {
+    begin = this->NumberOfPixels * run / this->NumberOfRuns;
+    end = this->NumberOfPixels * (run + 1) / this->NumberOfRuns;
+  }
+
+  std::size_t Slot(const TLabel label) const
+  {
+    if(this->Dense)
+      {
+      return static_cast<std::size_t>(label - this->MinimumLabel);
+      }
+    return std::lower_bound(this->SortedLabels.begin(), this->SortedLabels.end(), label) - this->SortedLabels.begin();
+  }
+
+  void FindRange(const unsigned int run)
+  {
+    std::size_t begin, end;
+    GetRun(run, begin, end);
+    TLabel minimum = this->Input[begin];
+    TLabel maximum = this->Input[begin];
+    for(std::size_t i = begin + 1; i < end; ++i)
+      {
+      minimum = std::min(minimum, this->Input[i]);
+      maximum = std::max(maximum, this->Input[i]);
+      }
+    this->RunMinimum[run] = minimum;
+    this->RunMaximum[run] = maximum;
+  }
+
+  void FindLabels(const unsigned int run)
+  {
+    std::size_t begin, end;
+    GetRun(run, begin, end);
+    std::vector<bool>& seen = this->RunSeen[run];
+    std::vector<TLabel>& firstSeen = this->RunFirstSeen[run];
+
+    if(this->Dense)
+      {
+      // The flags only cover the range of the run, which is often much smaller than that of the image.
+      const TLabel runMinimum = this->RunMinimum[run];
+      seen.assign(static_cast<std::size_t>(this->RunMaximum[run] - runMinimum) + 1, false);
+      for(std::size_t i = begin; i < end; ++i)
+        {
+        const std::size_t slot = static_cast<std::size_t>(this->Input[i] - runMinimum);
+        if(!seen[slot])
+          {
+          seen[slot] = true;
+          if(!this->OrderByOldLabel)
+            {
+            firstSeen.push_back(this->Input[i]);
+            }
+          }
+        }
+      return;
+      }
+
+    std::vector<TLabel>& labels = this->RunLabels[run];
+    labels.assign(this->Input + begin, this->Input + end);
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+    if(!this->OrderByOldLabel)
+      {
+      seen.assign(labels.size(), false);
+      for(std::size_t i = begin; i < end; ++i)
+        {
+        const std::size_t slot = std::lower_bound(labels.begin(), labels.end(), this->Input[i]) - labels.begin();
+        if(!seen[slot])
+          {
+          seen[slot] = true;
+          firstSeen.push_back(this->Input[i]);
+          }
+        }
+      }
+  }
+
+  void Relabel(const unsigned int run)
+  {
+    std::size_t begin, end;
+    GetRun(run, begin, end);
+    // Each pixel is read before it is written, so the input may be the output.
+    for(std::size_t i = begin; i < end; ++i)
+      {
+      this->Output[i] = this->NewLabels[Slot(this->Input[i])];
+      }
+  }
+
+  static ITK_THREAD_RETURN_TYPE ThreadFunction(void* arg)
+  {
+    itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+    RelabelSequentialData* data = static_cast<RelabelSequentialData*>(threadInfo->UserData);
+    const unsigned int run = threadInfo->ThreadID;
+    if(run < data->NumberOfRuns)
+      {
+      switch(data->Pass)
+        {
+        case 0: data->FindRange(run); break;
+        case 1: data->FindLabels(run); break;
+        default: data->Relabel(run); break;
+        }
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+};
 
-  // Keep only unique label ids
-  std::set<typename TImage::PixelType> uniqueLabels;
-  itk::ImageRegionConstIterator<TImage> imageIterator(input, input->GetLargestPossibleRegion());
+template<typename TImage>
+unsigned int RelabelSequential(typename TImage::Pointer input, typename TImage::Pointer output, const bool orderByOldLabel)
+{
+  typedef typename TImage::PixelType LabelType;
 
-  while(!imageIterator.IsAtEnd())
+  if(input.GetPointer() != output.GetPointer())
     {
-    uniqueLabels.insert(imageIterator.Get());
-    ++imageIterator;
+    output->SetRegions(input->GetLargestPossibleRegion());
+    output->Allocate();
     }
 
-  // Copy the set into a vector to induce an ordering
-  std::vector<typename TImage::PixelType> sequentialLabels;
-  for(typename std::set<typename TImage::PixelType>::iterator iterator = uniqueLabels.begin(); iterator != uniqueLabels.end(); iterator++)
+  RelabelSequentialData<LabelType> data;
+  data.Input = input->GetBufferPointer();
+  data.Output = output->GetBufferPointer();
+  data.NumberOfPixels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+  data.OrderByOldLabel = orderByOldLabel;
+  if(data.NumberOfPixels == 0)
     {
-    sequentialLabels.push_back(*iterator);
+    return 0;
     }
 
-  std::map <typename TImage::PixelType, typename TImage::PixelType> labelMap;
-  for(unsigned int i = 0; i < sequentialLabels.size(); ++i)
+  // Runs of at least 64K pixels, so that small images do not pay for the threads.
+  const std::size_t minimumRunSize = 65536;
+  data.NumberOfRuns = std::max<std::size_t>(1, std::min<std::size_t>(itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                                                      data.NumberOfPixels / minimumRunSize));
+  data.RunMinimum.resize(data.NumberOfRuns);
+  data.RunMaximum.resize(data.NumberOfRuns);
+  data.RunSeen.resize(data.NumberOfRuns);
+  data.RunLabels.resize(data.NumberOfRuns);
+  data.RunFirstSeen.resize(data.NumberOfRuns);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(data.NumberOfRuns);
+  threader->SetSingleMethod(RelabelSequentialData<LabelType>::ThreadFunction, &data);
+
+  // The range of the labels decides between the direct lookup and the binary search.
+  data.Pass = 0;
+  threader->SingleMethodExecute();
+  data.MinimumLabel = *std::min_element(data.RunMinimum.begin(), data.RunMinimum.end());
+  const LabelType maximumLabel = *std::max_element(data.RunMaximum.begin(), data.RunMaximum.end());
+  const double range = static_cast<double>(maximumLabel) - static_cast<double>(data.MinimumLabel) + 1;
+  data.Dense = range <= 2.0 * data.NumberOfPixels + 1024;
+
+  // Each run collects its labels on its own.
+  data.Pass = 1;
+  threader->SingleMethodExecute();
+
+  // Merge the runs into the table of new labels.
+  std::vector<bool> present;
+  if(data.Dense)
     {
-    labelMap[sequentialLabels[i]] = i;
+    present.assign(static_cast<std::size_t>(range), false);
+    for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+      {
+      const std::vector<bool>& seen = data.RunSeen[run];
+      const std::size_t offset = static_cast<std::size_t>(data.RunMinimum[run] - data.MinimumLabel);
+      for(std::size_t slot = 0; slot < seen.size(); ++slot)
+        {
+        if(seen[slot])
+          {
+          present[offset + slot] = true;
+          }
+        }
+      }
     }
-
-  // Set old values to new sequential labels
-  itk::ImageRegionIterator<TImage> outputIterator(output, output->GetLargestPossibleRegion());
-
-  while(!outputIterator.IsAtEnd())
+  else
     {
-    // We check the input image because if we change pixels in the output image and then search it later, we could accidentially write incorrect values.
-    outputIterator.Set(labelMap[input->GetPixel(outputIterator.GetIndex())]);
+    for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+      {
+      std::vector<LabelType> merged;
+      std::set_union(data.SortedLabels.begin(), data.SortedLabels.end(), data.RunLabels[run].begin(), data.RunLabels[run].end(),
+                     std::back_inserter(merged));
+      data.SortedLabels.swap(merged);
+      std::vector<LabelType>().swap(data.RunLabels[run]);
+      }
+    present.assign(data.SortedLabels.size(), true);
+    }
 
-    ++outputIterator;
+  data.NewLabels.assign(present.size(), 0);
+  std::size_t numberOfLabels = 0;
+  if(orderByOldLabel)
+    {
+    for(std::size_t slot = 0; slot < present.size(); ++slot)
+      {
+      if(present[slot])
+        {
+        data.NewLabels[slot] = static_cast<LabelType>(numberOfLabels++);
+        }
+      }
+    }
+  else
+    {
+    // The runs are in image order, and so are the labels each one saw first.
+    std::vector<bool> assigned(present.size(), false);
+    for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+      {
+      const std::vector<LabelType>& firstSeen = data.RunFirstSeen[run];
+      for(std::size_t i = 0; i < firstSeen.size(); ++i)
+        {
+        const std::size_t slot = data.Slot(firstSeen[i]);
+        if(!assigned[slot])
+          {
+          assigned[slot] = true;
+          data.NewLabels[slot] = static_cast<LabelType>(numberOfLabels++);
+          }
+        }
+      }
     }
 
+  data.Pass = 2;
+  threader->SingleMethodExecute();
+
+  return static_cast<unsigned int>(numberOfLabels);
 }
 
 template<typename TImage>
@@ -258,73 +614,190 @@ void BilateralAllChannels(const TVectorImage* image, TVectorImage* output, const
   DeepCopy<TVectorImage>(imageToVectorImageFilter->GetOutput(), output);
 }
 
+// State shared by the threads of ColorLabelsByAverageColor(). As in RelabelSequential(), the image is split into one
+// run of consecutive pixels per thread.
+template<typename TComponent, typename TLabel>
+struct ColorLabelsData
+{
+  const TComponent* Input;
+  const TLabel* Labels;
+  TComponent* Output;
+  std::size_t NumberOfPixels;
+  unsigned int NumberOfComponents;
+  unsigned int NumberOfLabels;
+  unsigned int NumberOfRuns;
+
+  // 0: sums of each run, 1: colored pixels.
+  unsigned int Pass;
+
+  // Color sums (NumberOfComponents per label) and pixel counts of each run.
+  std::vector<std::vector<double> > RunSums;
+  std::vector<std::vector<std::size_t> > RunCounts;
+
+  // Average color of each label, NumberOfComponents per label.
+  std::vector<TComponent> Colors;
+
+  void GetRun(const unsigned int run, std::size_t& begin, std::size_t& end) const
+  {
+    begin = this->NumberOfPixels * run / this->NumberOfRuns;
+    end = this->NumberOfPixels * (run + 1) / this->NumberOfRuns;
+  }
+
+  void Accumulate(const unsigned int run)
+  {
+    std::size_t begin, end;
+    GetRun(run, begin, end);
+    const unsigned int components = this->NumberOfComponents;
+    std::vector<double>& sums = this->RunSums[run];
+    std::vector<std::size_t>& counts = this->RunCounts[run];
+    sums.assign(static_cast<std::size_t>(this->NumberOfLabels) * components, 0);
+    counts.assign(this->NumberOfLabels, 0);
+
+    const TComponent* pixel = this->Input + begin * components;
+    for(std::size_t i = begin; i < end; ++i, pixel += components)
+      {
+      const std::size_t label = static_cast<std::size_t>(this->Labels[i]);
+      double* sum = &sums[label * components];
+      for(unsigned int component = 0; component < components; ++component)
+        {
+        sum[component] += pixel[component];
+        }
+      counts[label]++;
+      }
+  }
+
+  // Copy the color of each label to its pixels, with the number of components known to the compiler for the usual
+  // images so that the copy is unrolled.
+  template<unsigned int TComponents>
+  void Gather(const std::size_t begin, const std::size_t end)
+  {
+    const TComponent* colors = &this->Colors[0];
+    TComponent* pixel = this->Output + begin * TComponents;
+    for(std::size_t i = begin; i < end; ++i, pixel += TComponents)
+      {
+      const TComponent* color = colors + static_cast<std::size_t>(this->Labels[i]) * TComponents;
+      for(unsigned int component = 0; component < TComponents; ++component)
+        {
+        pixel[component] = color[component];
+        }
+      }
+  }
+
+  void Color(const unsigned int run)
+  {
+    std::size_t begin, end;
+    GetRun(run, begin, end);
+    const unsigned int components = this->NumberOfComponents;
+    switch(components)
+      {
+      case 1: Gather<1>(begin, end); return;
+      case 3: Gather<3>(begin, end); return;
+      case 4: Gather<4>(begin, end); return;
+      }
+    TComponent* pixel = this->Output + begin * components;
+    for(std::size_t i = begin; i < end; ++i, pixel += components)
+      {
+      const TComponent* color = &this->Colors[static_cast<std::size_t>(this->Labels[i]) * components];
+      std::copy(color, color + components, pixel);
+      }
+  }
+
+  static ITK_THREAD_RETURN_TYPE ThreadFunction(void* arg)
+  {
+    itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+    ColorLabelsData* data = static_cast<ColorLabelsData*>(threadInfo->UserData);
+    const unsigned int run = threadInfo->ThreadID;
+    if(run < data->NumberOfRuns)
+      {
+      if(data->Pass == 0)
+        {
+        data->Accumulate(run);
+        }
+      else
+        {
+        data->Color(run);
+        }
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+};
+
 template <typename TImage, typename TLabelImage>
-void ColorLabelsByAverageColor(const TImage* image, const TLabelImage* labelImage, TImage* output)
+void ColorLabelsByAverageColor(const TImage* image, const TLabelImage* labelImage, TImage* output, unsigned int numberOfLabels)
 {
+  typedef typename TImage::InternalPixelType ComponentType;
+  typedef typename TLabelImage::PixelType LabelType;
+
   output->SetRegions(labelImage->GetLargestPossibleRegion());
   output->SetNumberOfComponentsPerPixel(image->GetNumberOfComponentsPerPixel());
   output->Allocate();
 
-  // Determine how many labels there are
-  unsigned int maxLabel = Helpers::MaxValue<TLabelImage>(labelImage);
+  ColorLabelsData<ComponentType, LabelType> data;
+  data.Input = image->GetBufferPointer();
+  data.Labels = labelImage->GetBufferPointer();
+  data.Output = output->GetBufferPointer();
+  data.NumberOfPixels = labelImage->GetLargestPossibleRegion().GetNumberOfPixels();
+  data.NumberOfComponents = image->GetNumberOfComponentsPerPixel();
+  if(data.NumberOfPixels == 0)
+    {
+    return;
+    }
 
-//   typedef itk::Vector<float, 3> FloatPixelType; // This should really be based on the input image pixel dimension
-//   FloatPixelType zeroFloatPixel;
-//   //zeroFloatPixel.SetSize(3);
-//   zeroFloatPixel.Fill(0);
-  
-  typedef itk::VariableLengthVector<float> FloatPixelType;
-  FloatPixelType zeroFloatPixel;
-  zeroFloatPixel.SetSize(image->GetNumberOfComponentsPerPixel());
-  zeroFloatPixel.Fill(0);
-  
-  // We have to use float pixels or we would cause overflows while summing
-  std::vector<FloatPixelType> segmentFloatColors(maxLabel + 1, zeroFloatPixel); // +1 because Labels start at 0
-  std::vector<unsigned int> labelCount(maxLabel + 1, 0); // +1 because Labels start at 0
-  
-  //std::cout << "Coloring label " << labelId << std::endl;
-  FloatPixelType floatColor;
-  floatColor.SetSize(image->GetNumberOfComponentsPerPixel());
-  floatColor.Fill(0);
-  itk::ImageRegionConstIterator<TLabelImage> labelIterator(labelImage, labelImage->GetLargestPossibleRegion());
-  
-  while(!labelIterator.IsAtEnd())
+  // Labels start at 0. Without the count of the relabeling, find it from the largest label.
+  if(numberOfLabels == 0)
     {
-    labelCount[labelIterator.Get()]++;
-    floatColor[0] = image->GetPixel(labelIterator.GetIndex())[0];
-    floatColor[1] = image->GetPixel(labelIterator.GetIndex())[1];
-    floatColor[2] = image->GetPixel(labelIterator.GetIndex())[2];
-    
-    segmentFloatColors[labelIterator.Get()] += floatColor;
-    ++labelIterator;
-    } // end while
-    
-  typename TImage::PixelType zeroPixel;
-  zeroPixel.SetSize(image->GetNumberOfComponentsPerPixel());
-  zeroPixel.Fill(0);
-  std::vector<typename TImage::PixelType> segmentColors(maxLabel + 1, zeroPixel); // +1 because Labels start at 0
-  
-  typename TImage::PixelType colorPixel;
-  colorPixel.SetSize(image->GetNumberOfComponentsPerPixel());
-  colorPixel.Fill(0);
-  
-  for(unsigned int i = 0; i < segmentColors.size(); ++i)
+    numberOfLabels = static_cast<unsigned int>(*std::max_element(data.Labels, data.Labels + data.NumberOfPixels)) + 1;
+    }
+  data.NumberOfLabels = numberOfLabels;
+
+  // Runs of at least 64K pixels, and no more sums in all than there are pixels (e.g. with one label per few pixels).
+  const std::size_t minimumRunSize = 65536;
+  std::size_t numberOfRuns = std::min<std::size_t>(itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                                   data.NumberOfPixels / minimumRunSize);
+  numberOfRuns = std::min<std::size_t>(numberOfRuns, data.NumberOfPixels / numberOfLabels);
+  data.NumberOfRuns = std::max<std::size_t>(1, numberOfRuns);
+  data.RunSums.resize(data.NumberOfRuns);
+  data.RunCounts.resize(data.NumberOfRuns);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(data.NumberOfRuns);
+  threader->SetSingleMethod(ColorLabelsData<ComponentType, LabelType>::ThreadFunction, &data);
+
+  // The sums are in double, so that they are exact for integer images whatever the runs.
+  data.Pass = 0;
+  threader->SingleMethodExecute();
+
+  std::vector<double>& sums = data.RunSums[0];
+  std::vector<std::size_t>& counts = data.RunCounts[0];
+  for(unsigned int run = 1; run < data.NumberOfRuns; ++run)
     {
-    colorPixel[0] = segmentFloatColors[i][0]/static_cast<float>(labelCount[i]);
-    colorPixel[1] = segmentFloatColors[i][1]/static_cast<float>(labelCount[i]);
-    colorPixel[2] = segmentFloatColors[i][2]/static_cast<float>(labelCount[i]);
-
-    segmentColors[i] = colorPixel;
+    for(std::size_t i = 0; i < sums.size(); ++i)
+      {
+      sums[i] += data.RunSums[run][i];
+      }
+    for(std::size_t i = 0; i < counts.size(); ++i)
+      {
+      counts[i] += data.RunCounts[run][i];
+      }
     }
 
-  itk::ImageRegionConstIterator<TLabelImage> colorIterator(labelImage, labelImage->GetLargestPossibleRegion());
-  
-  while(!colorIterator.IsAtEnd())
+  // Labels without pixels are left black.
+  data.Colors.assign(sums.size(), 0);
+  for(unsigned int label = 0; label < numberOfLabels; ++label)
     {
-    output->SetPixel(colorIterator.GetIndex(), segmentColors[colorIterator.Get()]);
+    if(counts[label] == 0)
+      {
+      continue;
+      }
+    for(unsigned int component = 0; component < data.NumberOfComponents; ++component)
+      {
+      const std::size_t i = static_cast<std::size_t>(label) * data.NumberOfComponents + component;
+      data.Colors[i] = static_cast<ComponentType>(sums[i] / static_cast<double>(counts[label]));
+      }
+    }
 
-    ++colorIterator;
-    } // end while
+  data.Pass = 1;
+  threader->SingleMethodExecute();
 }
 
 } // end namespace
@@ -0,0 +1,377 @@
+/** @internal
+ ** @file     arena.c
+ ** @brief    Arena (bump) allocator - Definition
+ **/
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** @internal @brief Round a size up to the alignment of the blocks (that of @c malloc) */
+#define VL_ARENA_ALIGN(size) (((size) + 15) & ~ (vl_size) 15)
+
+/** @internal @brief Size of the chunks of ::vl_arena_new (0) */
+#define VL_ARENA_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+/** @internal @brief Chunk of an arena, followed by its data */
+typedef struct _VlArenaChunk
+{
+  struct _VlArenaChunk * next ;
+  vl_size size ;           /**< bytes of data */
+  vl_size used ;           /**< bytes handed out */
+} VlArenaChunk ;
+
+/** @internal @brief Data of a chunk */
+#define VL_ARENA_CHUNK_DATA(chunk) ((char *) (chunk) + VL_ARENA_ALIGN(sizeof(VlArenaChunk)))
+
+struct _VlArena
+{
+  vl_size chunkSize ;      /**< minimum size of a new chunk */
+  VlArenaChunk * chunks ;  /**< all the chunks, in order of allocation */
+  VlArenaChunk * current ; /**< chunk the blocks are taken from */
+  char * last ;            /**< last block handed out (NULL if freed) */
+} ;
+
+/** @internal @brief Header of the blocks of the allocation hooks */
+typedef struct _VlArenaBlock
+{
+  VlArena * arena ;        /**< arena of the block (NULL for the C library) */
+  vl_size size ;           /**< bytes requested */
+} VlArenaBlock ;
+
+/** @internal @brief Size of the header, keeping the blocks aligned */
+#define VL_ARENA_BLOCK_HEADER_SIZE VL_ARENA_ALIGN(sizeof(VlArenaBlock))
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Allocate a chunk
+ ** @param size bytes of data.
+ ** @return the new chunk, or NULL if out of memory.
+ **/
+
+static VlArenaChunk *
+_vl_arena_chunk_new (vl_size size)
+{
+  VlArenaChunk * chunk = malloc (VL_ARENA_ALIGN(sizeof(VlArenaChunk)) + size) ;
+  if (chunk) {
+    chunk->next = NULL ;
+    chunk->size = size ;
+    chunk->used = 0 ;
+  }
+  return chunk ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create an arena
+ ** @param chunkSize bytes requested from the C library at a time
+ **        (0 for 1 MB). Larger blocks get a chunk of their own.
+ ** @return new arena, or NULL if out of memory.
+ **/
+
+VL_EXPORT VlArena *
+vl_arena_new (vl_size chunkSize)
+{
+  VlArena * self = malloc (sizeof(VlArena)) ;
+  if (self) {
+    self->chunkSize = chunkSize ? chunkSize : VL_ARENA_DEFAULT_CHUNK_SIZE ;
+    self->chunks = NULL ;
+    self->current = NULL ;
+    self->last = NULL ;
+  }
+  return self ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Delete an arena and all its blocks
+ ** @param self arena.
+ **/
+
+VL_EXPORT void
+vl_arena_delete (VlArena * self)
+{
+  if (self) {
+    VlArenaChunk * chunk = self->chunks ;
+    while (chunk) {
+      VlArenaChunk * next = chunk->next ;
+      free (chunk) ;
+      chunk = next ;
+    }
+    free (self) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Free all the blocks of an arena
+ ** @param self arena.
+ **
+ ** The memory is kept for the next blocks. If it spans more than one
+ ** chunk, the chunks are replaced by a single one of their total size.
+ **/
+
+VL_EXPORT void
+vl_arena_reset (VlArena * self)
+{
+  if (self->chunks && self->chunks->next) {
+    VlArenaChunk * chunk = self->chunks ;
+    vl_size size = 0 ;
+    while (chunk) {
+      VlArenaChunk * next = chunk->next ;
+      size += chunk->size ;
+      free (chunk) ;
+      chunk = next ;
+    }
+    self->chunks = _vl_arena_chunk_new (size) ;
+  }
+  if (self->chunks) {
+    self->chunks->used = 0 ;
+  }
+  self->current = self->chunks ;
+  self->last = NULL ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Allocate a block from an arena
+ ** @param self arena.
+ ** @param n    bytes.
+ ** @return the block, aligned as @c malloc, or NULL if out of memory.
+ **/
+
+VL_EXPORT void *
+vl_arena_malloc (VlArena * self, vl_size n)
+{
+  VlArenaChunk * chunk = self->current ;
+  n = VL_ARENA_ALIGN(VL_MAX(n, 1)) ;
+
+  /* The first chunk from the current one with enough room, or a new one */
+  while (chunk && chunk->size - chunk->used < n) {
+    chunk = chunk->next ;
+  }
+  if (! chunk) {
+    chunk = _vl_arena_chunk_new (VL_MAX(n, self->chunkSize)) ;
+    if (! chunk) {
+      return NULL ;
+    }
+    if (self->chunks) {
+      VlArenaChunk * tail = self->current ;
+      while (tail->next) tail = tail->next ;
+      tail->next = chunk ;
+    } else {
+      self->chunks = chunk ;
+    }
+  }
+
+  self->current = chunk ;
+  self->last = VL_ARENA_CHUNK_DATA(chunk) + chunk->used ;
+  chunk->used += n ;
+  return self->last ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Free a block of an arena
+ ** @param self arena.
+ ** @param ptr  block (may be NULL).
+ **
+ ** Only the last block allocated is actually given back; the memory
+ ** of the others is reclaimed by ::vl_arena_reset.
+ **/
+
+VL_EXPORT void
+vl_arena_free (VlArena * self, void * ptr)
+{
+  if (ptr && ptr == self->last) {
+    self->current->used = self->last - VL_ARENA_CHUNK_DATA(self->current) ;
+    self->last = NULL ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Resize a block of an arena
+ ** @param self    arena.
+ ** @param ptr     block (NULL to allocate a new one).
+ ** @param oldSize size of @a ptr in bytes.
+ ** @param n       new size in bytes.
+ ** @return the block, or NULL if out of memory (@a ptr is then kept).
+ **
+ ** The last block allocated grows in place if its chunk has room; the
+ ** others are copied to a new block.
+ **/
+
+VL_EXPORT void *
+vl_arena_realloc (VlArena * self, void * ptr, vl_size oldSize, vl_size n)
+{
+  void * copy ;
+  if (ptr && ptr == self->last) {
+    vl_size offset = self->last - VL_ARENA_CHUNK_DATA(self->current) ;
+    vl_size size = VL_ARENA_ALIGN(VL_MAX(n, 1)) ;
+    if (offset + size <= self->current->size) {
+      self->current->used = offset + size ;
+      return ptr ;
+    }
+  }
+  copy = vl_arena_malloc (self, n) ;
+  if (copy && ptr) {
+    memcpy (copy, ptr, VL_MIN(oldSize, n)) ;
+  }
+  return copy ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Get the memory of an arena
+ ** @param self arena.
+ ** @return bytes obtained from the C library.
+ **/
+
+VL_EXPORT vl_size
+vl_arena_get_size (VlArena const * self)
+{
+  VlArenaChunk const * chunk ;
+  vl_size size = 0 ;
+  for (chunk = self->chunks ; chunk ; chunk = chunk->next) {
+    size += chunk->size ;
+  }
+  return size ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Get the memory handed out by an arena
+ ** @param self arena.
+ ** @return bytes of the blocks allocated since the last reset.
+ **/
+
+VL_EXPORT vl_size
+vl_arena_get_used (VlArena const * self)
+{
+  VlArenaChunk const * chunk ;
+  vl_size used = 0 ;
+  for (chunk = self->chunks ; chunk ; chunk = chunk->next) {
+    used += chunk->used ;
+  }
+  return used ;
+}
+
+/* -------------------------------------------------------------------
+ *                                                  Allocation hooks
+ * ---------------------------------------------------------------- */
+
+/** @internal @brief Allocate a block with its header from an arena (or the C library if NULL) */
+
+static void *
+_vl_arena_block_new (VlArena * arena, vl_size n)
+{
+  VlArenaBlock * block = arena ?
+    vl_arena_malloc (arena, VL_ARENA_BLOCK_HEADER_SIZE + n) :
+    malloc (VL_ARENA_BLOCK_HEADER_SIZE + n) ;
+  if (! block) {
+    return NULL ;
+  }
+  block->arena = arena ;
+  block->size = n ;
+  return (char *) block + VL_ARENA_BLOCK_HEADER_SIZE ;
+}
+
+/** @internal @brief ::vl_malloc of ::vl_arena_install */
+
+static void *
+_vl_arena_hook_malloc (size_t n)
+{
+  return _vl_arena_block_new (vl_get_thread_arena (), n) ;
+}
+
+/** @internal @brief ::vl_calloc of ::vl_arena_install */
+
+static void *
+_vl_arena_hook_calloc (size_t n, size_t size)
+{
+  void * ptr = _vl_arena_hook_malloc (n * size) ;
+  if (ptr) {
+    memset (ptr, 0, n * size) ;
+  }
+  return ptr ;
+}
+
+/** @internal @brief ::vl_free of ::vl_arena_install */
+
+static void
+_vl_arena_hook_free (void * ptr)
+{
+  if (ptr) {
+    VlArenaBlock * block = (VlArenaBlock *) ((char *) ptr - VL_ARENA_BLOCK_HEADER_SIZE) ;
+    if (block->arena) {
+      vl_arena_free (block->arena, block) ;
+    } else {
+      free (block) ;
+    }
+  }
+}
+
+/** @internal @brief ::vl_realloc of ::vl_arena_install
+ **
+ ** A block stays with the C library or with its arena
+ ** (see ::vl_arena_realloc).
+ **/
+
+static void *
+_vl_arena_hook_realloc (void * ptr, size_t n)
+{
+  VlArenaBlock * block ;
+
+  if (! ptr) {
+    return _vl_arena_hook_malloc (n) ;
+  }
+  block = (VlArenaBlock *) ((char *) ptr - VL_ARENA_BLOCK_HEADER_SIZE) ;
+  block = block->arena ?
+    vl_arena_realloc (block->arena, block,
+                      VL_ARENA_BLOCK_HEADER_SIZE + block->size,
+                      VL_ARENA_BLOCK_HEADER_SIZE + n) :
+    realloc (block, VL_ARENA_BLOCK_HEADER_SIZE + n) ;
+  if (! block) {
+    return NULL ;
+  }
+  block->size = n ;
+  return (char *) block + VL_ARENA_BLOCK_HEADER_SIZE ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Allocate the VLFeat memory from the thread arenas
+ **
+ ** Maps ::vl_malloc, ::vl_realloc, ::vl_calloc and ::vl_free (through
+ ** ::vl_set_alloc_func) to the arena of the calling thread
+ ** (::vl_set_thread_arena), or to the C library if it has none. As for
+ ** any remapping, no VLFeat memory may be allocated at the time.
+ **/
+
+VL_EXPORT void
+vl_arena_install ()
+{
+  vl_set_alloc_func (_vl_arena_hook_malloc,
+                     _vl_arena_hook_realloc,
+                     _vl_arena_hook_calloc,
+                     _vl_arena_hook_free) ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Set the arena of the calling thread
+ ** @param arena arena (NULL for the C library).
+ **
+ ** Once ::vl_arena_install has been called, the VLFeat allocations of
+ ** the calling thread come from @a arena. The arena is not owned by
+ ** the thread.
+ **/
+
+VL_EXPORT void
+vl_set_thread_arena (VlArena * arena)
+{
+  vl_get_thread_specific_state()->arena = arena ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Get the arena of the calling thread
+ ** @return the arena (NULL for the C library).
+ **/
+
+VL_EXPORT VlArena *
+vl_get_thread_arena ()
+{
+  return vl_get_thread_specific_state()->arena ;
+}
@@ -0,0 +1,44 @@
+/** @file     arena.h
+ ** @brief    Arena (bump) allocator
+ **/
+
+#ifndef VL_ARENA_H
+#define VL_ARENA_H
+
+#include "generic.h"
+
+/** ------------------------------------------------------------------
+ ** @brief Arena allocator
+ **
+ ** An arena hands out memory by bumping a pointer through large chunks
+ ** obtained from the C library, and reclaims all of it at once
+ ** (::vl_arena_reset). Freeing a block does nothing, except for the
+ ** last block allocated. After a reset the chunks are merged into one,
+ ** so a computation that allocates the same amount of memory every
+ ** time (e.g. quick shift on images of the same size) only calls
+ ** @c malloc the first time.
+ **
+ ** ::vl_arena_install maps ::vl_malloc, ::vl_realloc, ::vl_calloc and
+ ** ::vl_free to the arena of the calling thread
+ ** (::vl_set_thread_arena), or to the C library for threads without
+ ** one. An arena must only be used by one thread at a time.
+ **/
+
+typedef struct _VlArena VlArena ;
+
+VL_EXPORT VlArena * vl_arena_new (vl_size chunkSize) ;
+VL_EXPORT void vl_arena_delete (VlArena * self) ;
+VL_EXPORT void vl_arena_reset (VlArena * self) ;
+
+VL_EXPORT void * vl_arena_malloc (VlArena * self, vl_size n) ;
+VL_EXPORT void * vl_arena_realloc (VlArena * self, void * ptr, vl_size oldSize, vl_size n) ;
+VL_EXPORT void vl_arena_free (VlArena * self, void * ptr) ;
+
+VL_EXPORT vl_size vl_arena_get_size (VlArena const * self) ;
+VL_EXPORT vl_size vl_arena_get_used (VlArena const * self) ;
+
+VL_EXPORT void vl_arena_install () ;
+VL_EXPORT void vl_set_thread_arena (VlArena * arena) ;
+VL_EXPORT VlArena * vl_get_thread_arena () ;
+
+#endif
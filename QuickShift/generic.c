@@ -85,7 +85,8 @@ GNU GPLv2, or (at your option) any later version.
  ::vl_realloc, ::vl_calloc and ::vl_free). Remapping the memory
  allocation functions can be done only if there are no currently
  allocated VLFeat memory blocks or objects. The memory allocation
- functions are common to all threads.
+ functions are common to all threads; ::vl_arena_install maps them to
+ an arena per thread (::vl_set_thread_arena).
 
  VLFeat uses three rules that simplify handling exceptions:
 
@@ -147,7 +148,8 @@ GNU GPLv2, or (at your option) any later version.
    non-reentrant but thread-specific. These include: retrieving the
    last error by ::vl_get_last_error and obtaining the thread-specific
    random number generator by ::vl_get_rand. VLFeat makes such
-   operations thread-safe by operating on task-specific data.
+   operations thread-safe by operating on task-specific data, which
+   each thread finds without taking the global state lock.
 
  - <b>Global operations.</b> A small number of operations are
    non-reentrant <em>and</em> affect all threads simultaneously. These
@@ -565,6 +567,16 @@ vl_unlock_state ()
  ** @return @c true if SSE2 is present.
  **/
 
+/** @fn ::vl_cpu_has_avx2()
+ ** @brief Check for AVX2 instruction set
+ ** @return @c true if AVX2 is present and enabled by the OS.
+ **/
+
+/** @fn ::vl_cpu_has_avx512f()
+ ** @brief Check for AVX-512 foundation instruction set
+ ** @return @c true if AVX-512F is present and enabled by the OS.
+ **/
+
 /** ------------------------------------------------------------------
  ** @internal @brief Set last VLFeat error
  **
@@ -737,6 +749,7 @@ vl_thread_specific_state_new ()
   self->ticMark = 0 ;
 #endif
   vl_rand_init (&self->rand) ;
+  self->arena = NULL ;
 
   return self ;
 }
@@ -121,6 +121,9 @@ typedef struct _VlThreadSpecificState
   /* random number generator */
   VlRand rand ;
 
+  /* memory allocation (see arena.h) */
+  struct _VlArena * arena ;
+
   /* time */
 #if defined(VL_OS_WIN)
   LARGE_INTEGER ticFreq ;
@@ -180,6 +183,8 @@ VL_INLINE void vl_set_simd_enabled (vl_bool x) ;
 VL_INLINE vl_bool vl_get_simd_enabled () ;
 VL_INLINE vl_bool vl_cpu_has_sse3 () ;
 VL_INLINE vl_bool vl_cpu_has_sse2 () ;
+VL_INLINE vl_bool vl_cpu_has_avx2 () ;
+VL_INLINE vl_bool vl_cpu_has_avx512f () ;
 VL_INLINE int vl_get_num_cpus () ;
 VL_EXPORT VlRand * vl_get_rand () ;
 
@@ -302,12 +307,12 @@ vl_get_thread_specific_state ()
 #ifdef VL_DISABLE_THREADS
   return vl_get_state()->threadState ;
 #else
-  VlState * state ;
+  VlState * state = vl_get_state() ;
   VlThreadSpecificState * threadState ;
 
-  vl_lock_state() ;
-  state = vl_get_state() ;
-
+  /* The key is created once by the library constructor and each thread
+   * only reads and writes its own slot, so no lock is needed: threads
+   * using the library concurrently never wait for each other here. */
 #if defined(VL_THREADS_POSIX)
   threadState = (VlThreadSpecificState *) pthread_getspecific(state->threadKey) ;
 #elif defined(VL_THREADS_WIN)
@@ -316,15 +321,13 @@ vl_get_thread_specific_state ()
 
   if (! threadState) {
     threadState = vl_thread_specific_state_new () ;
-  }
-
 #if defined(VL_THREADS_POSIX)
-  pthread_setspecific(state->threadKey, threadState) ;
+    pthread_setspecific(state->threadKey, threadState) ;
 #elif defined(VL_THREADS_WIN)
-  TlsSetValue(state->tlsIndex, threadState) ;
+    TlsSetValue(state->tlsIndex, threadState) ;
 #endif
+  }
 
-  vl_unlock_state() ;
   return threadState ;
 #endif
 }
@@ -361,6 +364,26 @@ vl_cpu_has_sse2 ()
 #endif
 }
 
+VL_INLINE vl_bool
+vl_cpu_has_avx2 ()
+{
+#if defined(VL_ARCH_IX86) || defined(VL_ARCH_X64) || defined(VL_ARCH_IA64)
+  return vl_get_state()->cpuInfo.hasAVX2 ;
+#else
+  return 0 ;
+#endif
+}
+
+VL_INLINE vl_bool
+vl_cpu_has_avx512f ()
+{
+#if defined(VL_ARCH_IX86) || defined(VL_ARCH_X64) || defined(VL_ARCH_IA64)
+  return vl_get_state()->cpuInfo.hasAVX512F ;
+#else
+  return 0 ;
+#endif
+}
+
 VL_INLINE int
 vl_get_num_cpus ()
 {
@@ -14,6 +14,7 @@ GNU GPLv2, or (at your option) any later version.
 #include "host.h"
 #include "generic.h"
 #include <stdio.h>
+#include <string.h>
 
 /**
  @file host.h
@@ -329,6 +330,18 @@ it supports POSIX threads.
  ** Define this symbol to disable SSE2 support.
  **/
 
+/** @def VL_DISABLE_AVX2
+ ** @brief Defined if AVX2 support if disabled
+ **
+ ** Define this symbol to disable AVX2 support.
+ **/
+
+/** @def VL_DISABLE_AVX512
+ ** @brief Defined if AVX-512 support if disabled
+ **
+ ** Define this symbol to disable AVX-512 support.
+ **/
+
 /** @def VL_DISABLE_THREADS
  ** @brief Defined if multi-threading support is disabled
  **
@@ -356,7 +369,13 @@ it supports POSIX threads.
 VL_INLINE void
 _vl_cpuid (vl_int32* info, int function)
 {
-  __cpuid(info, function) ;
+  __cpuidex(info, function, 0) ;
+}
+
+VL_INLINE vl_uint64
+_vl_xgetbv (void)
+{
+  return _xgetbv(0) ;
 }
 #endif
 
@@ -376,17 +395,29 @@ _vl_cpuid (vl_int32* info, int function)
    "movl %%ebx, %1   \n" /* save what cpuid just put in %ebx */
    "popl %%ebx       \n" /* restore the old %ebx */
    : "=a"(info[0]), "=r"(info[1]), "=c"(info[2]), "=d"(info[3])
-   : "a"(function)
+   : "a"(function), "c"(0)
    : "cc") ; /* clobbered (cc=condition codes) */
 #else /* no -fPIC or -fPIC with a 64-bit target */
   __asm__ __volatile__
   ("cpuid"
    : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3])
-   : "a"(function)
+   : "a"(function), "c"(0)
    : "cc") ;
 #endif
 }
 
+VL_INLINE vl_uint64
+_vl_xgetbv (void)
+{
+  vl_uint32 eax, edx ;
+  /* xgetbv, spelled out for assemblers that do not know it */
+  __asm__ __volatile__
+  (".byte 0x0f, 0x01, 0xd0"
+   : "=a"(eax), "=d"(edx)
+   : "c"(0)) ;
+  return ((vl_uint64) edx << 32) | eax ;
+}
+
 #endif
 
 void
@@ -394,6 +425,8 @@ _vl_x86cpu_info_init (VlX86CpuInfo *self)
 {
   vl_int32 info [4] ;
   int max_func = 0 ;
+  vl_uint64 xcr0 = 0 ;
+  memset(self, 0, sizeof(VlX86CpuInfo)) ;
   _vl_cpuid(info, 0) ;
   max_func = info[0] ;
   self->vendor.words[0] = info[1] ;
@@ -408,6 +441,20 @@ _vl_x86cpu_info_init (VlX86CpuInfo *self)
     self->hasSSE3  = info[2] & (1 <<  0) ;
     self->hasSSE41 = info[2] & (1 << 19) ;
     self->hasSSE42 = info[2] & (1 << 20) ;
+
+    /* The AVX registers are only usable if the OS saves them
+     * (OSXSAVE set and the YMM, and for AVX-512 the ZMM/opmask,
+     * state enabled in XCR0) */
+    if (info[2] & (1 << 27)) {
+      xcr0 = _vl_xgetbv() ;
+    }
+    self->hasAVX   = (info[2] & (1 << 28)) && (xcr0 & 0x06) == 0x06 ;
+  }
+
+  if (max_func >= 7) {
+    _vl_cpuid(info, 7) ;
+    self->hasAVX2    = self->hasAVX && (info[1] & (1 << 5)) ;
+    self->hasAVX512F = self->hasAVX && (info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6 ;
   }
 }
 
@@ -421,14 +468,17 @@ _vl_x86cpu_info_to_string_copy (VlX86CpuInfo const *self)
       string = vl_malloc(sizeof(char) * length) ;
       if (string == NULL) break ;
     }
-    length = snprintf(string, length, "%s%s%s%s%s%s%s",
+    length = snprintf(string, length, "%s%s%s%s%s%s%s%s%s%s",
                       self->vendor.string,
                       self->hasMMX   ? " MMX" : "",
                       self->hasSSE   ? " SSE" : "",
                       self->hasSSE2  ? " SSE2" : "",
                       self->hasSSE3  ? " SSE3" : "",
                       self->hasSSE41 ? " SSE41" : "",
-                      self->hasSSE42 ? " SSE42" : "") ;
+                      self->hasSSE42 ? " SSE42" : "",
+                      self->hasAVX   ? " AVX" : "",
+                      self->hasAVX2  ? " AVX2" : "",
+                      self->hasAVX512F ? " AVX512F" : "") ;
     length += 1 ;
   }
   return string ;
@@ -482,6 +532,12 @@ vl_static_configuration_to_string_copy ()
 #endif
 #ifndef VL_DISABLE_SSE2
   ", SSE2"
+#endif
+#ifndef VL_DISABLE_AVX2
+  ", AVX2"
+#endif
+#ifndef VL_DISABLE_AVX512
+  ", AVX512"
 #endif
   ;
 
@@ -2,6 +2,15 @@
 #define __itkQuickShiftSegmentation_h
 
 #include "itkImageToImageFilter.h"
+#include "itkSimpleDataObjectDecorator.h"
+
+// Custom
+#include "DebugImageWriter.h"
+#include "RegionStatistics.h"
+#include "ScratchBuffer.h"
+
+// Segmentation
+#include "quickshift.h"
 
 namespace itk
 {
@@ -14,6 +23,9 @@ public:
   typedef ImageToImageFilter<TInputImage, TOutputLabelImage> Superclass;
   typedef SmartPointer< Self >        Pointer;
 
+  /** The output holding the statistics of each superpixel. */
+  typedef SimpleDataObjectDecorator< ::RegionStatistics > RegionStatisticsObjectType;
+
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
 
@@ -25,6 +37,8 @@ public:
   itkGetMacro( KernelSize, float);
 
   // Maximum distance between two pixels in the same label.
+  // An update that only changes MaxDist keeps the density of the previous one and only searches the parents again,
+  // or, if MaxDist did not grow, just cuts the previous forest (see CutForest()).
   itkSetMacro( MaxDist, float );
   itkGetMacro( MaxDist, float);
   
@@ -32,12 +46,78 @@ public:
   itkSetMacro( Ratio, float );
   itkGetMacro( Ratio, float);
 
+  // Run the quick shift engine in single instead of double precision. Off by default.
+  // The parents can differ where two densities are within float rounding of each other (see quickshift.c).
+  itkSetMacro( UseSinglePrecision, bool);
+  itkGetMacro( UseSinglePrecision, bool);
+  itkBooleanMacro( UseSinglePrecision);
+
+  // Evaluate the color weights of the density from an interpolated table instead of exp(). Off by default.
+  // Each weight is then within a relative 3e-5 of its exact value (see vl_quickshift_set_exp_table()).
+  itkSetMacro( UseExpTable, bool);
+  itkGetMacro( UseExpTable, bool);
+  itkBooleanMacro( UseExpTable);
+
+  // Approximate the density on a permutohedral lattice, in time independent of KernelSize. Off by default.
+  // The density is only accurate to 5-10 percent, so more parents change (see vl_quickshift_set_approximate_density()).
+  itkSetMacro( UseApproximateDensity, bool);
+  itkGetMacro( UseApproximateDensity, bool);
+  itkBooleanMacro( UseApproximateDensity);
+
+  // Estimate the density from this many random offsets of the kernel window, drawn once per update from DensitySeed,
+  // instead of the whole window. 0 (the default) sums the whole window. The relative error of the density decreases
+  // as one over the square root of the samples (see vl_quickshift_set_density_samples()).
+  itkSetMacro( DensitySamples, unsigned int);
+  itkGetMacro( DensitySamples, unsigned int);
+
+  // Seed of the offsets drawn by DensitySamples: the same seed gives the same segmentation. 0 by default.
+  itkSetMacro( DensitySeed, unsigned int);
+  itkGetMacro( DensitySeed, unsigned int);
+
+  // Move each pixel to the medoid of its kernel window (medoid shift) instead of the nearest denser pixel. Off by default.
+  // The parents then have no distances, so MaxDist, TileSize and UseApproximateDensity do not apply (see vl_quickshift_set_medoid()).
+  itkSetMacro( UseMedoidShift, bool);
+  itkGetMacro( UseMedoidShift, bool);
+  itkBooleanMacro( UseMedoidShift);
+
+  // Process the image in square tiles of this side, bounding the working memory per tile. 0 (the default) processes it whole.
+  // The segmentation is the same either way (see vl_quickshift_set_tile_size()).
+  itkSetMacro( TileSize, unsigned int);
+  itkGetMacro( TileSize, unsigned int);
+
+  // The statistics of each superpixel to compute into GetRegionStatistics(), as an or of RegionStatistics::Statistic.
+  // 0 (the default) computes none. The histogram settings of the RegionStatistics of the output are kept.
+  itkSetMacro( Statistics, unsigned int);
+  itkGetMacro( Statistics, unsigned int);
+
+  // Write intermediate images to DebugDirectory on a background thread. Off by default.
+  itkSetMacro( WriteDebugImages, bool);
+  itkGetMacro( WriteDebugImages, bool);
+
+  // Directory the debug images are written to.
+  itkSetStringMacro( DebugDirectory );
+  itkGetStringMacro( DebugDirectory );
+
   TOutputLabelImage* GetLabelImage();
   TInputImage* GetColoredImage();
+  RegionStatisticsObjectType* GetRegionStatistics();
+
+  // Relabel the outputs of the last update as if it had run with MaxDist = maxDist, by cutting the quick shift
+  // forest it kept: every pixel farther than maxDist from its parent becomes a root. This takes time linear in the
+  // number of pixels; the density and the parents are not recomputed. Returns false, and leaves the outputs alone,
+  // if there is no forest, it was computed with UseMedoidShift or from another input (or the input was modified
+  // since), or maxDist is larger than the MaxDist it was computed with.
+  bool CutForest(const float maxDist);
+
+  // Free the scratch buffers (and the quick shift forest) that are kept between updates.
+  void ReleaseWorkspace();
   
 protected:
   QuickShiftSegmentation();
-  ~QuickShiftSegmentation(){}
+  ~QuickShiftSegmentation()
+  {
+    ReleaseWorkspace();
+  }
 
   /** Does the real work. */
   virtual void GenerateData();
@@ -46,21 +126,25 @@ protected:
 
 private:
 
-  template<typename T>
-  std::vector<T> GetVectorFromArray(const T* array, const unsigned int size);
-  
-  std::vector<int> GetLabelsFromParents(const std::vector<int>& parents);
-  bool VectorsIdential(const std::vector<int>& v1, const std::vector<int>& v2);
-  std::vector<int> SequentialLabels(const std::vector<int>& v);
-  
-  unsigned int ComputeLinearValueIndex(const unsigned int row, const unsigned int col, const unsigned int width, const unsigned int height, const unsigned int channel)
-  {
-    return channel*width*height + row + height * col;
-  }
+  // Fill 'image' with the input scaled by Ratio, in buffer order: one plane per channel if the engine's SIMD kernels
+  // will read it, one padded run of channels per pixel otherwise. The layout is recorded in the workspace.
+  template<typename TValue>
+  void CopyToEngineImage(const TInputImage* input, TValue* image);
+
+  // Label each pixel by the root of its tree in the 'parents' forest, where the pixels farther than 'maxDist' from
+  // their parent are roots as well. The roots are numbered 0, 1, ... in linear order, so the labels are already
+  // sequential. Each pixel is visited at most twice. Returns the number of labels.
+  template<typename TDistance>
+  unsigned int GetLabelsFromParents(const int* parents, const TDistance* dists, const TDistance maxDist,
+                                    const unsigned int totalPixels, typename TOutputLabelImage::PixelType* labels);
+
+  // Fill the label, colored and statistics outputs from the forest in the workspace, cut at 'maxDist'.
+  void LabelForest(const double maxDist);
   
-  unsigned int ComputeLinearPixelIndex(const unsigned int row, const unsigned int col, const unsigned int height)
+  // Number of values per pixel in the engine image: the channels padded to a multiple of 4.
+  unsigned int GetEngineStride(const unsigned int channels)
   {
-    return row + height * col;
+    return (channels + 3) & ~3u;
   }
 
   QuickShiftSegmentation(const Self &); //purposely not implemented
@@ -69,6 +153,58 @@ private:
   float m_KernelSize;
   float m_MaxDist;
   float m_Ratio;
+  bool m_UseSinglePrecision;
+  bool m_UseExpTable;
+  bool m_UseApproximateDensity;
+  bool m_UseMedoidShift;
+  unsigned int m_DensitySamples;
+  unsigned int m_DensitySeed;
+  unsigned int m_TileSize;
+
+  unsigned int m_Statistics;
+
+  bool m_WriteDebugImages;
+  std::string m_DebugDirectory;
+  DebugImageWriter m_DebugImageWriter;
+
+  // What the density of the engine depends on. An update with the same settings reuses it.
+  struct DensitySettings
+  {
+    DensitySettings() : Input(NULL), InputTime(0), KernelSize(0), Ratio(0), UseExpTable(false),
+                        UseApproximateDensity(false), UseMedoidShift(false), DensitySamples(0), DensitySeed(0) {}
+
+    bool operator==(const DensitySettings& other) const
+    {
+      return Input == other.Input && InputTime == other.InputTime && KernelSize == other.KernelSize &&
+             Ratio == other.Ratio && UseExpTable == other.UseExpTable &&
+             UseApproximateDensity == other.UseApproximateDensity && UseMedoidShift == other.UseMedoidShift &&
+             DensitySamples == other.DensitySamples && DensitySeed == other.DensitySeed;
+    }
+
+    const TInputImage* Input;
+    ModifiedTimeType InputTime;
+    float KernelSize;
+    float Ratio;
+    bool UseExpTable;
+    bool UseApproximateDensity;
+    bool UseMedoidShift;
+    unsigned int DensitySamples;
+    unsigned int DensitySeed;
+  };
+
+  // Scratch buffers that are reused by every update on same-sized inputs.
+  struct Workspace
+  {
+    Workspace() : PlanarImage(false), Engine(NULL), Arena(NULL) {}
+
+    ScratchBuffer<vl_qs_type> Image; // The (row major) image handed to the quick shift engine
+    bool PlanarImage; // Whether Image has a plane per channel, or the padded channels of each pixel together
+    ScratchBuffer<vl_qs_type_f> SinglePrecisionImage; // Same, for the single precision engine
+    VlQS* Engine; // The engine of the last update, whose parents and dists CutForest() cuts
+    VlArena* Arena; // The memory of the engine's approximate density, reused by every update
+    DensitySettings Density; // The settings the engine's density was computed with (Input is NULL if none)
+  };
+  Workspace m_Workspace;
 };
 } //namespace ITK
 
@@ -11,6 +11,7 @@
 #include "itkBilateralImageFilter.h"
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkNumericTraits.h"
 #include "itkObjectFactory.h"
 
 // Segmentation
@@ -21,12 +22,13 @@ namespace itk
 
 template< typename TInputImage, typename TOutputLabelImage>
 QuickShiftSegmentation< TInputImage, TOutputLabelImage>
-::QuickShiftSegmentation() : m_KernelSize(5), m_MaxDist(10.0)
+::QuickShiftSegmentation() : m_KernelSize(5), m_MaxDist(10.0), m_UseSinglePrecision(false), m_UseExpTable(false), m_UseApproximateDensity(false), m_UseMedoidShift(false), m_DensitySamples(0), m_DensitySeed(0), m_TileSize(0), m_Statistics(0), m_WriteDebugImages(false), m_DebugDirectory(".")
 {
-  this->SetNumberOfRequiredOutputs(2);
+  this->SetNumberOfRequiredOutputs(3);
 
   this->SetNthOutput( 0, this->MakeOutput(0) );
   this->SetNthOutput( 1, this->MakeOutput(1) );
+  this->SetNthOutput( 2, this->MakeOutput(2) );
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
@@ -42,6 +44,9 @@ DataObject::Pointer QuickShiftSegmentation<TInputImage, TOutputLabelImage>::Make
     case 1:
       output = ( TInputImage::New() ).GetPointer(); // The output for the image colored by the average color in each region
       break;
+    case 2:
+      output = ( RegionStatisticsObjectType::New() ).GetPointer(); // The output for the statistics of each region
+      break;
     default:
       std::cerr << "No output " << idx << std::endl;
       output = NULL;
@@ -62,6 +67,57 @@ TInputImage* QuickShiftSegmentation<TInputImage, TOutputLabelImage>::GetColoredI
   return dynamic_cast< TInputImage * >(this->ProcessObject::GetOutput(1) );
 }
 
+template< typename TInputImage, typename TOutputLabelImage>
+typename QuickShiftSegmentation<TInputImage, TOutputLabelImage>::RegionStatisticsObjectType*
+QuickShiftSegmentation<TInputImage, TOutputLabelImage>::GetRegionStatistics()
+{
+  return dynamic_cast< RegionStatisticsObjectType * >(this->ProcessObject::GetOutput(2) );
+}
+
+template< typename TInputImage, typename TOutputLabelImage>
+void QuickShiftSegmentation< TInputImage, TOutputLabelImage>
+::ReleaseWorkspace()
+{
+  this->m_Workspace.Image.Release();
+  this->m_Workspace.SinglePrecisionImage.Release();
+  if(this->m_Workspace.Engine)
+    {
+    vl_quickshift_delete(this->m_Workspace.Engine);
+    this->m_Workspace.Engine = NULL;
+    }
+  this->m_Workspace.Density = DensitySettings();
+  if(this->m_Workspace.Arena)
+    {
+    vl_arena_delete(this->m_Workspace.Arena);
+    this->m_Workspace.Arena = NULL;
+    }
+}
+
+template< typename TInputImage, typename TOutputLabelImage>
+bool QuickShiftSegmentation< TInputImage, TOutputLabelImage>
+::CutForest(const float maxDist)
+{
+  VlQS* quickshift = this->m_Workspace.Engine;
+  if(!quickshift || vl_quickshift_get_medoid(quickshift) || maxDist > vl_quickshift_get_max_dist(quickshift))
+    {
+    return false;
+    }
+
+  // The outputs are colored from the input, so it must still be the image the forest was computed from.
+  const TInputImage* input = this->GetInput();
+  if(!input || input != this->m_Workspace.Density.Input || input->GetMTime() != this->m_Workspace.Density.InputTime ||
+     input->GetLargestPossibleRegion() != this->GetLabelImage()->GetLargestPossibleRegion())
+    {
+    return false;
+    }
+
+  // Cutting at the full distance reproduces the labels of the update exactly.
+  LabelForest(maxDist < vl_quickshift_get_max_dist(quickshift) ? maxDist : VL_QS_INF);
+  this->GetLabelImage()->Modified();
+  this->GetColoredImage()->Modified();
+  return true;
+}
+
 template< typename TInputImage, typename TOutputLabelImage>
 void QuickShiftSegmentation< TInputImage, TOutputLabelImage>
 ::GenerateData()
@@ -73,173 +129,286 @@ void QuickShiftSegmentation< TInputImage, TOutputLabelImage>
   unsigned int channels = input->GetNumberOfComponentsPerPixel();
   
   unsigned int totalPixels = width*height;
-  
-  vl_qs_type* image = new vl_qs_type[totalPixels*channels];
-  
-  itk::ImageRegionIterator<TInputImage> inputIterator(input, input->GetLargestPossibleRegion());
 
-  while(!inputIterator.IsAtEnd())
+  // The engine reads the pixels in the order of the ITK buffer (row major), with the channels of each
+  // pixel interleaved and padded to a multiple of 4 values. Its first (fastest varying) dimension is
+  // therefore the image width, and the parents it returns are linear indices into the ITK buffer.
+  // Its SIMD kernels read one plane per channel instead, except for the frames of the tiles, which
+  // they copy themselves; the image is then written in planes.
+  unsigned int stride = GetEngineStride(channels);
+
+  // Reuse the quick shift object of the previous update (kept for CutForest()) if it was made for an image of the
+  // same size and precision: it then only gets the new image, and processing allocates nothing.
+  const vl_type dataType = this->m_UseSinglePrecision ? VL_TYPE_FLOAT : VL_TYPE_DOUBLE;
+  VlQS* quickshift = this->m_Workspace.Engine;
+  if(quickshift && (quickshift->height != static_cast<int>(width) || quickshift->width != static_cast<int>(height) ||
+                    quickshift->channels != static_cast<int>(channels) || vl_quickshift_get_data_type(quickshift) != dataType))
     {
-    for (unsigned int component = 0; component < input->GetNumberOfComponentsPerPixel(); ++component) 
+    vl_quickshift_delete(quickshift);
+    quickshift = NULL;
+    this->m_Workspace.Engine = NULL;
+    this->m_Workspace.Density = DensitySettings();
+    }
+
+  // If the density would come out the same as that of the engine (e.g. only MaxDist changed), the engine keeps it,
+  // and its image.
+  DensitySettings density;
+  density.Input = input;
+  density.InputTime = input->GetMTime();
+  density.KernelSize = this->m_KernelSize;
+  density.Ratio = this->m_Ratio;
+  density.UseExpTable = this->m_UseExpTable;
+  density.UseApproximateDensity = this->m_UseApproximateDensity;
+  density.UseMedoidShift = this->m_UseMedoidShift;
+  density.DensitySamples = this->m_DensitySamples;
+  density.DensitySeed = this->m_DensitySeed;
+  const bool sameDensity = quickshift && density == this->m_Workspace.Density;
+
+  if(sameDensity)
+    {
+    itkDebugMacro(<< "Reusing the density of the previous update.");
+    }
+  else if(this->m_UseSinglePrecision)
+    {
+    vl_qs_type_f* image = this->m_Workspace.SinglePrecisionImage.Reserve(totalPixels*stride);
+    CopyToEngineImage(input, image);
+    if(quickshift)
       {
-      unsigned int linearIndex = ComputeLinearValueIndex(inputIterator.GetIndex()[1], inputIterator.GetIndex()[0], width, height, component);
-      //std::cout << "linearIndex: " << linearIndex << std::endl;
-      //float noise = 255.0f * drand48();
-      image[linearIndex] = inputIterator.Get()[component] * this->m_Ratio;
+      vl_quickshift_set_image_f(quickshift, image);
       }
-    ++inputIterator;
+    else
+      {
+      quickshift = vl_quickshift_new_f(image, width, height, channels);
+      }
+    }
+  else
+    {
+    vl_qs_type* image = this->m_Workspace.Image.Reserve(totalPixels*stride);
+    CopyToEngineImage(input, image);
+    if(quickshift)
+      {
+      vl_quickshift_set_image(quickshift, image);
+      }
+    else
+      {
+      quickshift = vl_quickshift_new(image, width, height, channels);
+      }
+    }
+  if(this->m_Workspace.PlanarImage)
+    {
+    vl_quickshift_set_layout(quickshift, 1, totalPixels);
+    }
+  else
+    {
+    vl_quickshift_set_layout(quickshift, stride, 1);
     }
 
-  // Create a new quick shift object
-  VlQS* quickshift = vl_quickshift_new(image, height, width, channels);
+  // The lattice of the approximate density is then carved from memory kept between updates.
+  if(!this->m_Workspace.Arena)
+    {
+    this->m_Workspace.Arena = vl_arena_new(0);
+    }
+  vl_quickshift_set_arena(quickshift, this->m_Workspace.Arena);
 
   // Configure quick shift by setting the kernel size (vl_quickshift_set_kernel_size)
-  // and the maximum gap (vl_quickshift_set_max_dist).
+  // and, below, the maximum gap (vl_quickshift_set_max_dist).
   // The latter is in principle not necessary, but useful to speedup processing.
   std::cout << "vl_quickshift kernel: " << m_KernelSize << " dist: " << m_MaxDist << std::endl;
   vl_quickshift_set_kernel_size(quickshift, this->m_KernelSize);
 
-  vl_quickshift_set_max_dist(quickshift, this->m_MaxDist);
+  vl_quickshift_set_exp_table(quickshift, this->m_UseExpTable);
 
-  vl_quickshift_process(quickshift);
-  std::cout << "Finished processing." << std::endl;
+  vl_quickshift_set_approximate_density(quickshift, this->m_UseApproximateDensity);
 
-  // Retrieve the parents (These can be used to segment the image in superpixels.)
-  int* parents = vl_quickshift_get_parents(quickshift);
+  vl_quickshift_set_density_samples(quickshift, this->m_DensitySamples);
 
-  std::cout << "GetVectorFromArray()" << std::endl;
-  std::vector<int> parentsVector = GetVectorFromArray(parents, totalPixels);
+  vl_quickshift_set_density_seed(quickshift, this->m_DensitySeed);
 
-  std::cout << "GetLabelsFromParents()" << std::endl;
-  std::vector<int> labels = GetLabelsFromParents(parentsVector);
+  vl_quickshift_set_tile_size(quickshift, this->m_TileSize);
 
-  // Construct label image from label array
-  typename TOutputLabelImage::Pointer outputLabelImage = this->GetLabelImage(); // One of the output ports
-  outputLabelImage->SetRegions(input->GetLargestPossibleRegion());
-  outputLabelImage->Allocate();
+  vl_quickshift_set_medoid(quickshift, this->m_UseMedoidShift);
 
-  itk::ImageRegionIterator<TOutputLabelImage> labelIterator(outputLabelImage, outputLabelImage->GetLargestPossibleRegion());
+  // The engine splits the image rows between the filter's threads (see SetNumberOfThreads()).
+  vl_quickshift_set_num_threads(quickshift, this->GetNumberOfThreads());
 
-  unsigned int labelId = 0;
-  while(!labelIterator.IsAtEnd())
+  // With the same density, the parents within a smaller MaxDist are those of the forest of the larger one, cut at
+  // MaxDist (as CutForest() does). A larger MaxDist only needs the parents searched again, and the parents of medoid
+  // shift do not depend on it.
+  double cutDist = VL_QS_INF;
+  if(!sameDensity)
     {
-    unsigned int linearIndex = ComputeLinearPixelIndex(labelIterator.GetIndex()[1], labelIterator.GetIndex()[0], height);
-    labelIterator.Set(labels[linearIndex]);
-
-    ++labelIterator;
-    labelId++;
+    vl_quickshift_set_max_dist(quickshift, this->m_MaxDist);
+    vl_quickshift_process(quickshift);
+    std::cout << "Finished processing." << std::endl;
+    }
+  else if(!this->m_UseMedoidShift && this->m_MaxDist > vl_quickshift_get_max_dist(quickshift))
+    {
+    vl_quickshift_set_max_dist(quickshift, this->m_MaxDist);
+    vl_quickshift_process_parents(quickshift);
+    itkDebugMacro(<< "Finished searching the parents.");
+    }
+  else if(!this->m_UseMedoidShift && this->m_MaxDist < vl_quickshift_get_max_dist(quickshift))
+    {
+    cutDist = this->m_MaxDist;
     }
 
-  // Delete the quick shift object
-  vl_quickshift_delete(quickshift);
-
-  std::cout << "RelabelSequential()" << std::endl;
-  Helpers::RelabelSequential<TOutputLabelImage>(outputLabelImage, outputLabelImage); // This is the 0th output port of the filter
+  // Keep the forest, so that it can be cut at smaller distances later
+  this->m_Workspace.Engine = quickshift;
+  this->m_Workspace.Density = density;
 
-  Helpers::WriteImage<TOutputLabelImage>(outputLabelImage, "QuickShift_LabelImage.mha");
+  // Construct the label image straight from the parents
+  typename TOutputLabelImage::Pointer outputLabelImage = this->GetLabelImage(); // One of the output ports
+  outputLabelImage->SetRegions(input->GetLargestPossibleRegion());
+  outputLabelImage->Allocate();
 
-  std::cout << "ColorLabelsByAverageColor()" << std::endl;
-  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(input, this->GetLabelImage(), this->GetColoredImage());
-  Helpers::WriteImage<TInputImage>(this->GetColoredImage(), "QuickShift_ColoredImage.mha");
+  LabelForest(cutDist);
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
-template<typename T>
-std::vector<T> QuickShiftSegmentation< TInputImage, TOutputLabelImage>
-::GetVectorFromArray(const T* array, const unsigned int size)
+void QuickShiftSegmentation< TInputImage, TOutputLabelImage>
+::LabelForest(const double maxDist)
 {
-  std::vector<T> myVector(size);
-  for(unsigned int i = 0; i < size; ++i)
+  VlQS* quickshift = this->m_Workspace.Engine;
+  TOutputLabelImage* outputLabelImage = this->GetLabelImage();
+  const unsigned int totalPixels = outputLabelImage->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  // Retrieve the parents (These can be used to segment the image in superpixels.)
+  int* parents = vl_quickshift_get_parents(quickshift);
+
+  itkDebugMacro(<< "GetLabelsFromParents()");
+  unsigned int numberOfLabels;
+  if(vl_quickshift_get_data_type(quickshift) == VL_TYPE_FLOAT)
     {
-    myVector[i] = array[i];
+    numberOfLabels = GetLabelsFromParents<vl_qs_type_f>(parents, vl_quickshift_get_dists_f(quickshift), static_cast<vl_qs_type_f>(maxDist),
+                                                        totalPixels, outputLabelImage->GetBufferPointer());
+    }
+  else
+    {
+    numberOfLabels = GetLabelsFromParents<vl_qs_type>(parents, vl_quickshift_get_dists(quickshift), maxDist,
+                                                      totalPixels, outputLabelImage->GetBufferPointer());
     }
-  return myVector;
-}
-
-template< typename TInputImage, typename TOutputLabelImage>
-std::vector<int> QuickShiftSegmentation< TInputImage, TOutputLabelImage>
-::GetLabelsFromParents(const std::vector<int>& parents)
-{
-  // The values of the 'parents' array indicate the linear index of the pixel that is the parent of each pixel.
-  // Compare to the LABELS output of [LABELS CLUSTERS] = VL_FLATMAP(MAP) in Matlab.
-  std::vector<int> labels(parents.size(), 0);
 
-  // Initialize by copying
-  for(unsigned int i = 0; i < parents.size(); ++i)
+  if(this->m_WriteDebugImages)
     {
-    labels[i] = parents[i];
+    this->m_DebugImageWriter.Write<TOutputLabelImage>(outputLabelImage, this->m_DebugDirectory, "QuickShift_LabelImage.mha");
     }
-  
-  std::vector<int> tempLabels(parents.size(), 0);
-  std::vector<int> oldLabels(parents.size(), 0);
-  
-  while(!VectorsIdential(oldLabels, labels))
+
+  itkDebugMacro(<< "ColorLabelsByAverageColor()");
+  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(this->GetInput(), outputLabelImage, this->GetColoredImage(),
+                                                                     numberOfLabels);
+  if(this->m_WriteDebugImages)
     {
-    oldLabels = labels;
-    for(unsigned int i = 0; i < parents.size(); ++i)
-      {
-      //std::cout << "Replacing " << labels[i] << " with " << labels[labels[i]] << std::endl;
-      tempLabels[i] = labels[labels[i]]; // Replace my label with my parents label.
-      }
-    labels = tempLabels;
+    this->m_DebugImageWriter.Write<TInputImage>(this->GetColoredImage(), this->m_DebugDirectory, "QuickShift_ColoredImage.mha");
     }
 
-  return labels;
+  // The statistics, or an empty table so that none of a previous update is left.
+  if(this->m_Statistics)
+    {
+    this->GetRegionStatistics()->Get().Compute(this->GetInput(), outputLabelImage, this->m_Statistics, numberOfLabels);
+    }
+  else
+    {
+    this->GetRegionStatistics()->Get().Clear();
+    }
+  this->GetRegionStatistics()->Modified();
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
-bool QuickShiftSegmentation< TInputImage, TOutputLabelImage>
-::VectorsIdential(const std::vector<int>& v1, const std::vector<int>& v2)
+template<typename TValue>
+void QuickShiftSegmentation< TInputImage, TOutputLabelImage>
+::CopyToEngineImage(const TInputImage* input, TValue* image)
 {
-  if(v1.size() != v2.size())
+  unsigned int channels = input->GetNumberOfComponentsPerPixel();
+  unsigned int stride = GetEngineStride(channels);
+  const std::size_t totalPixels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  // The SIMD kernels only read planes; the frames of the tiles are planar copies made by the engine.
+  this->m_Workspace.PlanarImage = vl_quickshift_has_simd() && (this->m_TileSize <= 0 || this->m_UseMedoidShift);
+
+  itk::ImageRegionConstIterator<TInputImage> inputIterator(input, input->GetLargestPossibleRegion());
+
+  // Both the input and the engine image (each of its planes) are traversed linearly.
+  if(this->m_Workspace.PlanarImage)
     {
-    std::cerr << "Vectors must be the same size!" << std::endl;
-    exit(-1);
+    for(std::size_t pixel = 0; !inputIterator.IsAtEnd(); ++pixel, ++inputIterator)
+      {
+      typename TInputImage::PixelType value = inputIterator.Get();
+      for (unsigned int component = 0; component < channels; ++component)
+        {
+        image[component * totalPixels + pixel] = value[component] * this->m_Ratio;
+        }
+      }
+    return;
     }
-  for(unsigned int i = 0; i < v1.size(); ++i)
+
+  TValue* pixel = image;
+  while(!inputIterator.IsAtEnd())
     {
-    if(v1[i] != v2[i])
+    typename TInputImage::PixelType value = inputIterator.Get();
+    for (unsigned int component = 0; component < channels; ++component) 
+      {
+      pixel[component] = value[component] * this->m_Ratio;
+      }
+    for (unsigned int component = channels; component < stride; ++component) 
       {
-      return false;
+      pixel[component] = 0;
       }
+    pixel += stride;
+    ++inputIterator;
     }
-  return true;
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
-std::vector<int> QuickShiftSegmentation< TInputImage, TOutputLabelImage>
-::SequentialLabels(const std::vector<int>& v)
+template<typename TDistance>
+unsigned int QuickShiftSegmentation< TInputImage, TOutputLabelImage>
+::GetLabelsFromParents(const int* parents, const TDistance* dists, const TDistance maxDist,
+                       const unsigned int totalPixels, typename TOutputLabelImage::PixelType* labels)
 {
-  std::vector<int> sequentialLabels(v.size());
-  std::set<int> uniqueLabelsSet;
-  for(unsigned int i = 0; i < v.size(); ++i)
-    {
-    uniqueLabelsSet.insert(v[i]);
-    }
+  // The values of the 'parents' array indicate the linear index of the pixel that is the parent of each pixel.
+  // Compare to the LABELS output of [LABELS CLUSTERS] = VL_FLATMAP(MAP) in Matlab.
+  typedef typename TOutputLabelImage::PixelType LabelType;
+  const LabelType unlabeled = itk::NumericTraits<LabelType>::max();
 
-  std::vector<int> uniqueLabelsVector;
-  for(typename std::set<int>::iterator iterator = uniqueLabelsSet.begin(); iterator != uniqueLabelsSet.end(); iterator++)
+  // Number the roots in linear order and mark every other pixel as not yet labeled.
+  unsigned int numberOfLabels = 0;
+  for(unsigned int i = 0; i < totalPixels; ++i)
     {
-    uniqueLabelsVector.push_back(*iterator);
+    if(parents[i] == static_cast<int>(i) || dists[i] > maxDist)
+      {
+      labels[i] = numberOfLabels++;
+      }
+    else
+      {
+      labels[i] = unlabeled;
+      }
     }
 
-  std::map<int,int> labelMap;
-  for(unsigned int i = 0; i < uniqueLabelsVector.size(); ++i)
+  // Walk up from each unlabeled pixel to the first labeled ancestor, then walk the same path again
+  // writing that label, so that later walks stop as soon as they reach this path.
+  for(unsigned int i = 0; i < totalPixels; ++i)
     {
-    labelMap[uniqueLabelsVector[i]] = i;
-    }
-    
-  // Set old values to new sequential labels
-  unsigned int sequentialLabelId = 0;
+    if(labels[i] != unlabeled)
+      {
+      continue;
+      }
 
-  for(unsigned int i = 0; i < v.size(); ++i)
-    {
-    sequentialLabels[i] = labelMap[v[i]];
+    int ancestor = parents[i];
+    while(labels[ancestor] == unlabeled)
+      {
+      ancestor = parents[ancestor];
+      }
+    const LabelType label = labels[ancestor];
+
+    int pixel = i;
+    while(labels[pixel] == unlabeled)
+      {
+      labels[pixel] = label;
+      pixel = parents[pixel];
+      }
     }
-    
-  return sequentialLabels;
-}
 
+  return numberOfLabels;
+}
 
 }// end namespace
 
@@ -0,0 +1,441 @@
+/** @internal
+ ** @file     lattice.c
+ ** @brief    Permutohedral lattice Gaussian filtering - Definition
+ **/
+
+#include "lattice.h"
+
+#include <math.h>
+#include <string.h>
+
+/** @internal @brief Initial number of slots of the vertex hash table */
+#define VL_LATTICE_INITIAL_TABLE_SIZE 65536
+
+struct _VlLattice
+{
+  VlArena * arena ;        /**< arena of the buffers (NULL for ::vl_malloc) */
+  int dimension ;          /**< feature dimension d */
+  int numPoints ;          /**< number of points */
+
+  /* Vertices: d integer coordinates (the last one is implied) and a value each */
+  int numVertices ;
+  int vertexCapacity ;
+  int * keys ;
+  double * values ;
+
+  /* Open addressing hash table from keys to vertex indices (-1 = empty) */
+  int tableSize ;
+  int * table ;
+
+  /* For each point, the d+1 vertices of its simplex and their barycentric weights */
+  int * offsets ;
+  double * weights ;
+
+  /* Scratch space of vl_lattice_splat and vl_lattice_blur */
+  double * scaleFactor ;
+  double * elevated ;
+  double * barycentric ;
+  int * rem0 ;
+  int * rank ;
+  int * canonical ;
+  int * key ;
+} ;
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Allocate a buffer of a lattice
+ ** @param arena arena of the lattice (NULL for ::vl_malloc).
+ ** @param n     bytes.
+ **/
+
+static void *
+_vl_lattice_malloc (VlArena * arena, vl_size n)
+{
+  return arena ? vl_arena_malloc (arena, n) : vl_malloc (n) ;
+}
+
+/** @internal @brief Resize a buffer of a lattice (see ::_vl_lattice_malloc) */
+
+static void *
+_vl_lattice_realloc (VlArena * arena, void * ptr, vl_size oldSize, vl_size n)
+{
+  return arena ? vl_arena_realloc (arena, ptr, oldSize, n) : vl_realloc (ptr, n) ;
+}
+
+/** @internal @brief Free a buffer of a lattice (see ::_vl_lattice_malloc) */
+
+static void
+_vl_lattice_free (VlArena * arena, void * ptr)
+{
+  if (arena) {
+    vl_arena_free (arena, ptr) ;
+  } else {
+    vl_free (ptr) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Hash of a vertex key
+ **/
+
+static vl_uint32
+_vl_lattice_hash (int const * key, int d)
+{
+  vl_uint32 h = 0 ;
+  int i ;
+  for (i = 0 ; i < d ; ++i) {
+    h = (h + (vl_uint32) key [i]) * 2531011u ;
+  }
+  return h ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Find the vertex with the given key
+ ** @param self lattice.
+ ** @param key  vertex key.
+ ** @param create add the vertex if it does not exist.
+ ** @return the vertex index, or -1 if it does not exist and @a create is false.
+ **/
+
+static int
+_vl_lattice_find (VlLattice * self, int const * key, vl_bool create) ;
+
+static void
+_vl_lattice_grow_table (VlLattice * self)
+{
+  int i ;
+  _vl_lattice_free (self->arena, self->table) ;
+  self->tableSize *= 2 ;
+  self->table = _vl_lattice_malloc (self->arena, self->tableSize * sizeof(int)) ;
+  for (i = 0 ; i < self->tableSize ; ++i) {
+    self->table [i] = -1 ;
+  }
+  for (i = 0 ; i < self->numVertices ; ++i) {
+    int const * key = self->keys + i * self->dimension ;
+    vl_uint32 slot = _vl_lattice_hash (key, self->dimension) & (self->tableSize - 1) ;
+    while (self->table [slot] >= 0) {
+      slot = (slot + 1) & (self->tableSize - 1) ;
+    }
+    self->table [slot] = i ;
+  }
+}
+
+static int
+_vl_lattice_find (VlLattice * self, int const * key, vl_bool create)
+{
+  int d = self->dimension ;
+  vl_uint32 slot ;
+
+  if (create && 2 * (self->numVertices + 1) > self->tableSize) {
+    _vl_lattice_grow_table (self) ;
+  }
+
+  slot = _vl_lattice_hash (key, d) & (self->tableSize - 1) ;
+  while (1) {
+    int vertex = self->table [slot] ;
+    if (vertex < 0) {
+      if (! create) {
+        return -1 ;
+      }
+      if (self->numVertices == self->vertexCapacity) {
+        int capacity = self->vertexCapacity ;
+        self->vertexCapacity *= 2 ;
+        self->keys = _vl_lattice_realloc (self->arena, self->keys,
+                                          capacity * d * sizeof(int),
+                                          self->vertexCapacity * d * sizeof(int)) ;
+        self->values = _vl_lattice_realloc (self->arena, self->values,
+                                            capacity * sizeof(double),
+                                            self->vertexCapacity * sizeof(double)) ;
+      }
+      vertex = self->numVertices ++ ;
+      memcpy (self->keys + vertex * d, key, d * sizeof(int)) ;
+      self->values [vertex] = 0 ;
+      self->table [slot] = vertex ;
+      return vertex ;
+    }
+    if (memcmp (self->keys + vertex * d, key, d * sizeof(int)) == 0) {
+      return vertex ;
+    }
+    slot = (slot + 1) & (self->tableSize - 1) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create a lattice
+ ** @param dimension feature dimension.
+ ** @param numPoints number of points that will be splatted.
+ ** @return new lattice.
+ **/
+
+VL_EXPORT VlLattice *
+vl_lattice_new (int dimension, int numPoints)
+{
+  return vl_lattice_new_with_arena (NULL, dimension, numPoints) ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create a lattice in an arena
+ ** @param arena     arena (NULL for ::vl_malloc).
+ ** @param dimension feature dimension.
+ ** @param numPoints number of points that will be splatted.
+ ** @return new lattice.
+ **
+ ** Same as ::vl_lattice_new, but the lattice and all its buffers come
+ ** straight from @a arena, without going through ::vl_malloc. They
+ ** are released by ::vl_lattice_delete or by resetting the arena.
+ **/
+
+VL_EXPORT VlLattice *
+vl_lattice_new_with_arena (VlArena * arena, int dimension, int numPoints)
+{
+  VlLattice * self = _vl_lattice_malloc (arena, sizeof(VlLattice)) ;
+  int d = dimension ;
+  int i, j ;
+
+  self->arena = arena ;
+  self->dimension = d ;
+  self->numPoints = numPoints ;
+
+  self->numVertices = 0 ;
+  self->vertexCapacity = 1024 ;
+  self->keys = _vl_lattice_malloc (arena, self->vertexCapacity * d * sizeof(int)) ;
+  self->values = _vl_lattice_malloc (arena, self->vertexCapacity * sizeof(double)) ;
+
+  self->tableSize = VL_LATTICE_INITIAL_TABLE_SIZE ;
+  self->table = _vl_lattice_malloc (arena, self->tableSize * sizeof(int)) ;
+  for (i = 0 ; i < self->tableSize ; ++i) {
+    self->table [i] = -1 ;
+  }
+
+  self->offsets = _vl_lattice_malloc (arena, (vl_size) numPoints * (d + 1) * sizeof(int)) ;
+  self->weights = _vl_lattice_malloc (arena, (vl_size) numPoints * (d + 1) * sizeof(double)) ;
+
+  self->scaleFactor = _vl_lattice_malloc (arena, d * sizeof(double)) ;
+  self->elevated = _vl_lattice_malloc (arena, (d + 1) * sizeof(double)) ;
+  self->barycentric = _vl_lattice_malloc (arena, (d + 2) * sizeof(double)) ;
+  self->rem0 = _vl_lattice_malloc (arena, (d + 1) * sizeof(int)) ;
+  self->rank = _vl_lattice_malloc (arena, (d + 1) * sizeof(int)) ;
+  self->canonical = _vl_lattice_malloc (arena, (d + 1) * (d + 1) * sizeof(int)) ;
+  self->key = _vl_lattice_malloc (arena, (d + 1) * sizeof(int)) ;
+
+  /* Scale of the elevation matrix so that the blur matches a unit
+   * standard deviation Gaussian (Adams et al., Sec. 3.1) */
+  for (i = 0 ; i < d ; ++i) {
+    self->scaleFactor [i] = (d + 1) * sqrt (2.0 / 3.0) / sqrt ((double) (i + 1) * (i + 2)) ;
+  }
+
+  /* Vertices of the canonical simplex */
+  for (i = 0 ; i <= d ; ++i) {
+    for (j = 0 ; j <= d - i ; ++j) {
+      self->canonical [i * (d + 1) + j] = i ;
+    }
+    for (j = d - i + 1 ; j <= d ; ++j) {
+      self->canonical [i * (d + 1) + j] = i - (d + 1) ;
+    }
+  }
+
+  return self ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Delete a lattice
+ ** @param self lattice.
+ **/
+
+VL_EXPORT void
+vl_lattice_delete (VlLattice * self)
+{
+  if (self) {
+    _vl_lattice_free (self->arena, self->keys) ;
+    _vl_lattice_free (self->arena, self->values) ;
+    _vl_lattice_free (self->arena, self->table) ;
+    _vl_lattice_free (self->arena, self->offsets) ;
+    _vl_lattice_free (self->arena, self->weights) ;
+    _vl_lattice_free (self->arena, self->scaleFactor) ;
+    _vl_lattice_free (self->arena, self->elevated) ;
+    _vl_lattice_free (self->arena, self->barycentric) ;
+    _vl_lattice_free (self->arena, self->rem0) ;
+    _vl_lattice_free (self->arena, self->rank) ;
+    _vl_lattice_free (self->arena, self->canonical) ;
+    _vl_lattice_free (self->arena, self->key) ;
+    _vl_lattice_free (self->arena, self) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Add a point to the lattice
+ ** @param self    lattice.
+ ** @param point   index of the point (each point is splatted once).
+ ** @param feature the @c dimension features of the point.
+ ** @param value   value of the point.
+ **/
+
+VL_EXPORT void
+vl_lattice_splat (VlLattice * self, int point, double const * feature, double value)
+{
+  int d = self->dimension ;
+  double * elevated = self->elevated ;
+  double * barycentric = self->barycentric ;
+  int * rem0 = self->rem0 ;
+  int * rank = self->rank ;
+  int * key = self->key ;
+  double downFactor = 1.0 / (d + 1) ;
+  double sm = 0 ;
+  int sum = 0 ;
+  int i, j, remainder ;
+
+  /* Elevate the feature onto the hyperplane x_0 + ... + x_d = 0 */
+  for (i = d ; i > 0 ; --i) {
+    double cf = feature [i - 1] * self->scaleFactor [i - 1] ;
+    elevated [i] = sm - i * cf ;
+    sm += cf ;
+  }
+  elevated [0] = sm ;
+
+  /* Closest remainder-0 lattice point */
+  for (i = 0 ; i <= d ; ++i) {
+    double v = downFactor * elevated [i] ;
+    int up = (int) ceil (v) * (d + 1) ;
+    int down = (int) floor (v) * (d + 1) ;
+    rem0 [i] = (up - elevated [i] < elevated [i] - down) ? up : down ;
+    sum += rem0 [i] ;
+  }
+  sum /= d + 1 ;
+
+  /* Rank the differences to find the enclosing simplex */
+  for (i = 0 ; i <= d ; ++i) {
+    rank [i] = 0 ;
+  }
+  for (i = 0 ; i < d ; ++i) {
+    double di = elevated [i] - rem0 [i] ;
+    for (j = i + 1 ; j <= d ; ++j) {
+      if (di < elevated [j] - rem0 [j]) {
+        rank [i] ++ ;
+      } else {
+        rank [j] ++ ;
+      }
+    }
+  }
+  for (i = 0 ; i <= d ; ++i) {
+    rank [i] += sum ;
+    if (rank [i] < 0) {
+      rank [i] += d + 1 ;
+      rem0 [i] += d + 1 ;
+    } else if (rank [i] > d) {
+      rank [i] -= d + 1 ;
+      rem0 [i] -= d + 1 ;
+    }
+  }
+
+  /* Barycentric coordinates */
+  for (i = 0 ; i <= d + 1 ; ++i) {
+    barycentric [i] = 0 ;
+  }
+  for (i = 0 ; i <= d ; ++i) {
+    double v = (elevated [i] - rem0 [i]) * downFactor ;
+    barycentric [d - rank [i]] += v ;
+    barycentric [d - rank [i] + 1] -= v ;
+  }
+  barycentric [0] += 1.0 + barycentric [d + 1] ;
+
+  /* Splat onto the vertices of the simplex */
+  for (remainder = 0 ; remainder <= d ; ++remainder) {
+    int vertex ;
+    for (i = 0 ; i < d ; ++i) {
+      key [i] = rem0 [i] + self->canonical [remainder * (d + 1) + rank [i]] ;
+    }
+    vertex = _vl_lattice_find (self, key, VL_TRUE) ;
+    self->offsets [(vl_size) point * (d + 1) + remainder] = vertex ;
+    self->weights [(vl_size) point * (d + 1) + remainder] = barycentric [remainder] ;
+    self->values [vertex] += barycentric [remainder] * value ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Blur the splatted values
+ ** @param self lattice.
+ **
+ ** Convolves the values with [1 2 1]/4 along each of the d+1 lattice
+ ** directions.
+ **/
+
+VL_EXPORT void
+vl_lattice_blur (VlLattice * self)
+{
+  int d = self->dimension ;
+  int * neighbor = self->key ;
+  double * blurred = _vl_lattice_malloc (self->arena, self->numVertices * sizeof(double)) ;
+  int i, j, k ;
+
+  for (j = 0 ; j <= d ; ++j) {
+    for (i = 0 ; i < self->numVertices ; ++i) {
+      int const * key = self->keys + i * d ;
+      double sum = 2 * self->values [i] ;
+      int n ;
+
+      /* Neighbor one step back along direction j */
+      for (k = 0 ; k < d ; ++k) {
+        neighbor [k] = key [k] + 1 ;
+      }
+      if (j < d) {
+        neighbor [j] = key [j] - d ;
+      }
+      n = _vl_lattice_find (self, neighbor, VL_FALSE) ;
+      if (n >= 0) {
+        sum += self->values [n] ;
+      }
+
+      /* Neighbor one step forward along direction j */
+      for (k = 0 ; k < d ; ++k) {
+        neighbor [k] = key [k] - 1 ;
+      }
+      if (j < d) {
+        neighbor [j] = key [j] + d ;
+      }
+      n = _vl_lattice_find (self, neighbor, VL_FALSE) ;
+      if (n >= 0) {
+        sum += self->values [n] ;
+      }
+
+      blurred [i] = 0.25 * sum ;
+    }
+    memcpy (self->values, blurred, self->numVertices * sizeof(double)) ;
+  }
+
+  _vl_lattice_free (self->arena, blurred) ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Interpolate the blurred values at a point
+ ** @param self  lattice.
+ ** @param point index of a splatted point.
+ ** @return the filtered value at the point.
+ **/
+
+VL_EXPORT double
+vl_lattice_slice (VlLattice const * self, int point)
+{
+  int d = self->dimension ;
+  int const * offsets = self->offsets + (vl_size) point * (d + 1) ;
+  double const * weights = self->weights + (vl_size) point * (d + 1) ;
+  double value = 0 ;
+  int remainder ;
+  for (remainder = 0 ; remainder <= d ; ++remainder) {
+    value += weights [remainder] * self->values [offsets [remainder]] ;
+  }
+  return value ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Get the number of lattice vertices
+ ** @param self lattice.
+ ** @return number of vertices touched by the splatted points.
+ **/
+
+VL_EXPORT int
+vl_lattice_get_num_vertices (VlLattice const * self)
+{
+  return self->numVertices ;
+}
@@ -0,0 +1,46 @@
+/** @file     lattice.h
+ ** @brief    Permutohedral lattice Gaussian filtering
+ **/
+
+#ifndef VL_LATTICE_H
+#define VL_LATTICE_H
+
+#include "generic.h"
+#include "arena.h"
+
+/** ------------------------------------------------------------------
+ ** @brief Permutohedral lattice
+ **
+ ** Approximates the Gauss transform
+ **
+ ** @f[
+ **   v'_i = \sum_j \exp\left(-\frac{1}{2} \| f_i - f_j \|^2\right) v_j
+ ** @f]
+ **
+ ** of a set of points with features @f$ f_i \in R^d @f$ and values
+ ** @f$ v_i @f$ in time linear in the number of points and independent
+ ** of the spread of the kernel (A. Adams, J. Baek and M. A. Davis,
+ ** &ldquo;Fast High-Dimensional Filtering Using the Permutohedral
+ ** Lattice&rdquo;, in <em>Proc. Eurographics</em>, 2010).
+ **
+ ** The values are splatted onto the vertices of the lattice simplices
+ ** enclosing the points (::vl_lattice_splat), blurred along each lattice
+ ** direction (::vl_lattice_blur) and interpolated back at the points
+ ** (::vl_lattice_slice). Features are in units of the kernel standard
+ ** deviation; the result approximates @f$ v' @f$ up to a constant factor.
+ **/
+
+typedef struct _VlLattice VlLattice ;
+
+VL_EXPORT VlLattice * vl_lattice_new (int dimension, int numPoints) ;
+VL_EXPORT VlLattice * vl_lattice_new_with_arena (VlArena * arena, int dimension, int numPoints) ;
+VL_EXPORT void vl_lattice_delete (VlLattice * self) ;
+
+VL_EXPORT void vl_lattice_splat (VlLattice * self, int point,
+                                 double const * feature, double value) ;
+VL_EXPORT void vl_lattice_blur (VlLattice * self) ;
+VL_EXPORT double vl_lattice_slice (VlLattice const * self, int point) ;
+
+VL_EXPORT int vl_lattice_get_num_vertices (VlLattice const * self) ;
+
+#endif
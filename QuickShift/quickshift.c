@@ -22,6 +22,10 @@ GNU GPLv2, or (at your option) any later version.
 - @ref quickshift-intro
 - @ref quickshift-usage
 - @ref quickshift-tech
+- @ref quickshift-precision
+- @ref quickshift-approximate
+- @ref quickshift-simd
+- @ref quickshift-tiles
 
 @section quickshift-intro Overview
 
@@ -59,15 +63,31 @@ for Mode Seeking&rdquo;, in <em>Proc. ECCV</em>, 2008.
 @section quickshift-usage Usage
 
 - Create a new quick shift object (::vl_quickshift_new). The object
-  can be reused for multiple images of the same size.
+  can be reused for multiple images of the same size
+  (::vl_quickshift_set_image); after the first image its buffers are
+  reused, so processing allocates no memory (except for the lattice of
+  the approximate density, which can come from an arena,
+  ::vl_quickshift_set_arena).
 - Configure quick shift by setting the kernel size
   (::vl_quickshift_set_kernel_size) and the maximum gap
   (::vl_quickshift_set_max_dist). The latter is in principle not
   necessary, but useful to speedup processing.
+- Optionally describe an interleaved or row major image
+  (::vl_quickshift_set_layout).
+- Optionally split the work between several threads
+  (::vl_quickshift_set_num_threads).
+- Optionally approximate the density in time independent of the
+  kernel size (::vl_quickshift_set_approximate_density), or compute
+  it on a random sample of the window
+  (::vl_quickshift_set_density_samples).
+- Optionally process a very large image in tiles
+  (::vl_quickshift_set_tile_size).
 - Process an image (::vl_quickshift_process).
 - Retrieve the parents (::vl_quickshift_get_parents) and the distances
   (::vl_quickshift_get_dists). These can be used to segment
   the image in superpixels.
+- Optionally change the maximum gap and search the parents again,
+  reusing the density (::vl_quickshift_process_parents).
 - Delete the quick shift object (::vl_quickshift_delete).
 
 @section quickshift-tech Technical details
@@ -114,16 +134,425 @@ pixel <em>parent(x, y)</em> that achieves the minimum distance in
 \right).
 @f]
 
+
+@section quickshift-search Parent search
+
+The parent is searched among the pixels within @f$ \lceil \tau \rceil
+@f$ along each axis, but these are visited in order of increasing
+spatial distance @f$ (x - x')^2 + (y - y')^2 @f$, which is a lower
+bound of @f$ \mathrm{dist} @f$. The search stops at the first pixel
+whose spatial distance exceeds the best distance so far, so with a
+large maximum distance it usually only visits a few rings around the
+pixel. Ties between pixels at the same distance go to the smaller
+linear index, as in a scan of the whole window, so the parents do not
+depend on the search order.
+
+@section quickshift-precision Precision
+
+The engine is compiled twice: ::vl_quickshift_new creates an object
+working in double precision (::vl_qs_type) and ::vl_quickshift_new_f
+one working in single precision (::vl_qs_type_f). The single precision
+engine halves the memory traffic and doubles the SIMD width of the
+density and distance loops.
+
+The two engines compute the same distances exactly as long as the
+feature values and their squared differences are representable in a
+@c float (e.g. 8 bit images scaled by a power of two). The densities
+differ by rounding only, about @f$ (2R+1)^2 \cdot 2^{-24} @f$ relative
+to their value, so a pixel gets a different parent only when two
+candidate densities are within that tolerance of each other.
+@c quickshiftPrecision reports the fraction of such pixels on a set of
+images and fails when it exceeds a given tolerance.
+
+@section quickshift-approximate Approximate density
+
+The exact density visits a @f$ (2R+1)^2 @f$ window with @f$ R = \lceil
+3\sigma \rceil @f$ around each pixel, so its cost grows with the square
+of the kernel size. With ::vl_quickshift_set_approximate_density the
+density is instead computed by splatting the features
+@f$ (x,y,I(x,y))/\sigma @f$ onto a permutohedral lattice, blurring it
+and slicing it back at the pixels (::VlLattice). This costs
+@f$ O(d^2) @f$ per pixel, where @f$ d @f$ is the number of channels plus
+two, whatever the kernel size.
+
+The approximate density is proportional to the exact one up to the
+lattice interpolation error (typically 5-10 percent per pixel), so the parents
+of pixels with similar densities may change. Only the density is
+approximated: the parents are then searched exactly, within the maximum
+distance. Medoid shift always uses the exact density, since it needs
+the kernel votes as well. @c quickshiftDensityReport compares both
+densities and the resulting segmentations on a set of images.
+
+@section quickshift-sampled Sampled density
+
+With ::vl_quickshift_set_density_samples the exact density only sums
+a random sample of the window offsets, drawn once per image with
+probabilities proportional to their spatial weights
+@f$ \exp(-(\delta_x^2 + \delta_y^2) / 2\sigma^2) @f$ and shared by
+all the pixels. Each drawn offset is weighted by the number of times it
+was drawn, so that the density is an unbiased estimate of the exact one,
+and the offsets never drawn are skipped. The density then costs about
+as many kernel evaluations per pixel as there are samples, against
+@f$ (2R+1)^2 @f$ for the whole window; the relative error of the
+density of a pixel decreases as the inverse square root of the number
+of samples. The sample is drawn from a ::VlRand seeded by
+::vl_quickshift_set_density_seed, so the results are reproducible.
+
+@section quickshift-simd SIMD
+
+The quick shift density and parent search run on SSE2, AVX2 or
+AVX-512 vectors when the CPU supports them, choosing the widest
+instruction set at run time (::vl_cpu_has_avx512f, ::vl_cpu_has_avx2,
+::vl_cpu_has_sse2); ::vl_set_simd_enabled turns them off. Each vector
+lane processes a different pixel with the operations of the scalar
+code, so the results are the same bit for bit whatever the CPU. Pixels
+whose windows cross the first or last image row and the exponentials
+use the scalar code.
+
+The kernels read the channels of a run of pixels from contiguous
+planes, so they only process planar images (@c pixelStride = 1, see
+::vl_quickshift_set_layout); an interleaved image is processed by the
+scalar code, except in tiled mode, whose frames are planar copies. A
+caller that lays out the image itself should make it planar when
+::vl_quickshift_has_simd is true.
+
+Medoid shift runs on the same kernels. The votes @f$ M_i @f$ of a run of
+pixels are accumulated in place over the whole window, so the run only
+touches the same @f$ K + 2 @f$ vectors of votes, and the scores
+@f$ Q_{ij} @f$ are evaluated for all the lanes at once, term by term
+in the order of the scalar code.
+
+@section quickshift-tiles Tiles
+
+Besides the parents and distances, processing a whole image keeps the
+density of every pixel. With ::vl_quickshift_set_tile_size
+the image is instead split into square tiles of the given side. The
+parents of a tile only depend on the density of the tile plus a halo of
+@f$ \lceil \tau \rceil @f$ pixels, which only depends on the image of the
+tile plus a halo of @f$ \lceil \tau \rceil + \lceil 3\sigma \rceil @f$
+pixels; each thread copies this frame, computes its density and the
+parents of the tile, and moves on to the next tile. Apart from the
+parents and distances, the memory is then one frame per thread.
+
+The parents are indices into the whole image, so trees cross the tile
+boundaries, and they are the same as without tiles. The halo is
+computed once per tile it belongs to, so tiles should be several times
+larger than the halo. The approximate density is computed on the frame
+of each tile, in the coordinates of the image; it may still differ
+slightly near the frame boundaries, where the lattice misses the
+pixels outside the frame.
+Medoid shift ignores the tile size.
     
 **/
-  
+
+#ifndef VL_QUICKSHIFT_INSTANTIATING
+
 #include "quickshift.h"
 #include "mathop.h"
+#include "lattice.h"
+#include "random.h"
+#include "quickshift_kernels.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
 
+/** @internal @brief Alignment of the pieces of the scratch buffer */
+#define VL_QS_SCRATCH_ALIGN(size) (((size) + 63) & ~ (vl_size) 63)
+
+/** @internal @brief Thread running a block (see ::_vl_quickshift_run_blocks) */
+typedef struct
+{
+#if ! defined(VL_DISABLE_THREADS) && defined(VL_THREADS_POSIX)
+  pthread_t thread ;
+#endif
+  vl_bool started ;
+} _VlQSThread ;
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Get the scratch buffer of a quick shift object
+ ** @param q    quick shift object.
+ ** @param size number of bytes needed.
+ ** @return a buffer of at least @a size bytes, aligned as ::vl_malloc.
+ **
+ ** The buffer is kept by the object and only reallocated when it must
+ ** grow, so processing images of the same size allocates nothing after
+ ** the first one. Its contents are not preserved.
+ **/
+
+static char *
+_vl_quickshift_get_scratch (VlQS * q, vl_size size)
+{
+  if (size > q->scratchSize) {
+    if (q->scratch) vl_free(q->scratch) ;
+    q->scratch = vl_malloc(size) ;
+    q->scratchSize = size ;
+  }
+  return (char *) q->scratch ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Run a function on each of a set of blocks, one thread per block
+ ** @param blocks     array of blocks.
+ ** @param blockSize  size of a block in bytes.
+ ** @param numBlocks  number of blocks.
+ ** @param function   function called with a pointer to each block.
+ ** @param threads    @a numBlocks thread records (the first is unused).
+ **
+ ** Returns once every call has returned. The calling thread processes
+ ** the first block. Without thread support (or if a thread cannot be
+ ** created) the blocks are processed in turn by the calling thread.
+ **/
+
+static void
+_vl_quickshift_run_blocks (void * blocks, vl_size blockSize, int numBlocks,
+                           void * (*function) (void *), _VlQSThread * threads)
+{
+  int b ;
+#if ! defined(VL_DISABLE_THREADS) && defined(VL_THREADS_POSIX)
+  for (b = 1 ; b < numBlocks ; ++b) {
+    threads[b].started = (pthread_create(&threads[b].thread, NULL, function,
+                                         (char *) blocks + b * blockSize) == 0) ;
+    if (! threads[b].started) {
+      function((char *) blocks + b * blockSize) ;
+    }
+  }
+  function(blocks) ;
+  for (b = 1 ; b < numBlocks ; ++b) {
+    if (threads[b].started) {
+      pthread_join(threads[b].thread, NULL) ;
+    }
+  }
+#else
+  (void) threads ;
+  for (b = 0 ; b < numBlocks ; ++b) {
+    function((char *) blocks + b * blockSize) ;
+  }
+#endif
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Order of the parent search: nearer window offsets first
+ ** @param a offset (d1, d2).
+ ** @param b offset (d1, d2).
+ **
+ ** Offsets at the same spatial distance are taken in the order of the
+ ** window scan (by d2, then d1).
+ **/
+
+static int
+_vl_quickshift_compare_offsets (void const * a, void const * b)
+{
+  int const * p = (int const *) a ;
+  int const * r = (int const *) b ;
+  int sp = p[0]*p[0] + p[1]*p[1] ;
+  int sr = r[0]*r[0] + r[1]*r[1] ;
+  if (sp != sr) return (sp > sr) - (sp < sr) ;
+  if (p[1] != r[1]) return (p[1] > r[1]) - (p[1] < r[1]) ;
+  return (p[0] > r[0]) - (p[0] < r[0]) ;
+}
+
+#define FLT VL_TYPE_FLOAT
+#define VL_QUICKSHIFT_INSTANTIATING
+#include "quickshift.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define VL_QUICKSHIFT_INSTANTIATING
+#include "quickshift.c"
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Create a quick shift object of the given data type
+ **/
+
+static VlQS *
+_vl_quickshift_new(void const * image, vl_type dataType,
+                   int height, int width, int channels)
+{
+  VlQS * q = vl_malloc(sizeof(VlQS));
+  vl_size dataSize = vl_get_type_size(dataType) ;
+
+  q->dataType = dataType;
+  q->image    = (void *)image;
+  q->height   = height;
+  q->width    = width;
+  q->channels = channels;
+  q->pixelStride   = 1;
+  q->channelStride = height*width;
+
+  q->medoid   = VL_FALSE;
+  q->numThreads = 1;
+  q->expTable = VL_FALSE;
+  q->approximateDensity = VL_FALSE;
+  q->densitySamples = 0;
+  q->densitySeed = 0;
+  q->tileSize = 0;
+  q->arena = NULL;
+  q->scratch = NULL;
+  q->scratchSize = 0;
+  q->tau      = VL_MAX(height,width)/50;
+  q->sigma    = VL_MAX(2, q->tau/3);
+
+  q->dists    = vl_calloc(height*width, dataSize);
+  q->parents  = vl_calloc(height*width, sizeof(int)); 
+  q->density  = vl_calloc(height*width, dataSize) ;
+
+  return q;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create a quick shift object
+ ** @param image
+ ** @param height
+ ** @param width
+ ** @param channels
+ **
+ ** @return New quick shift object.
+ **/
+ 
+VL_EXPORT
+VlQS *
+vl_quickshift_new(vl_qs_type const * image, int height, int width,
+                       int channels)
+{
+  return _vl_quickshift_new(image, VL_TYPE_DOUBLE, height, width, channels) ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create a single precision quick shift object
+ ** @param image
+ ** @param height
+ ** @param width
+ ** @param channels
+ **
+ ** Same as ::vl_quickshift_new, but the image, the density and the
+ ** distances are single precision.
+ **
+ ** @return New quick shift object.
+ **/
+ 
+VL_EXPORT
+VlQS *
+vl_quickshift_new_f(vl_qs_type_f const * image, int height, int width,
+                         int channels)
+{
+  return _vl_quickshift_new(image, VL_TYPE_FLOAT, height, width, channels) ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Create a quick shift objet
+ ** @param q quick shift object.
+ **/
+
+VL_EXPORT
+void vl_quickshift_process(VlQS * q)
+{
+  switch (q->dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_quickshift_process_f(q, VL_FALSE) ;
+      break ;
+    default:
+      _vl_quickshift_process_d(q, VL_FALSE) ;
+      break ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Search the parents again, keeping the density
+ ** @param q quick shift object.
+ **
+ ** Recomputes the parents and distances from the density of the last
+ ** ::vl_quickshift_process, e.g. after a change of the maximum distance
+ ** (::vl_quickshift_set_max_dist), at the cost of the parent search
+ ** alone. The image and the kernel size must be those of that call.
+ ** Without a density to reuse (in tiled mode, see
+ ** ::vl_quickshift_set_tile_size) and for medoid shift, whose parents
+ ** need more than the density, this is the same as
+ ** ::vl_quickshift_process.
+ **/
+
+VL_EXPORT
+void vl_quickshift_process_parents(VlQS * q)
+{
+  vl_bool searchOnly = q->density && q->tileSize <= 0 && ! q->medoid ;
+  switch (q->dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_quickshift_process_f(q, searchOnly) ;
+      break ;
+    default:
+      _vl_quickshift_process_d(q, searchOnly) ;
+      break ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Whether the SIMD kernels run on this CPU
+ ** @return true if they are enabled (::vl_set_simd_enabled) and
+ **         supported by the build and the CPU.
+ **
+ ** They only process planar images (see @ref quickshift-simd).
+ **/
+
+VL_EXPORT
+vl_bool vl_quickshift_has_simd(void)
+{
+  _VlQSDensityRow_d densityRow ;
+  _VlQSParentsRow_d parentsRow ;
+  _VlQSMedoidDensityRow_d medoidDensityRow ;
+  _VlQSMedoidParentsRow_d medoidParentsRow ;
+  return _vl_quickshift_select_kernels_d(&densityRow, &parentsRow,
+                                         &medoidDensityRow, &medoidParentsRow) > 0 ;
+}
+
+/** -----------------------------------------------------------------
+ ** @brief Delete quick shift object
+ ** @param q quick shift object.
+ **/
+
+void vl_quickshift_delete(VlQS * q)
+{
+  if (q) {
+    if (q->parents) 
+    {
+      vl_free(q->parents);
+    }
+    if (q->dists)   
+    {
+      vl_free(q->dists);
+    }
+    if (q->density) 
+    {
+      vl_free(q->density);
+    }
+    if (q->scratch) 
+    {
+      vl_free(q->scratch);
+    }
+    
+    vl_free(q);
+  }
+}
+
+/* VL_QUICKSHIFT_INSTANTIATING */
+#else
+
+#if (FLT == VL_TYPE_FLOAT)
+#  define T float
+#  define SFX f
+#  define T_INF VL_QS_INF_F
+#  define T_EXP expf
+#  define T_SQRT sqrtf
+#else
+#  define T double
+#  define SFX d
+#  define T_INF VL_QS_INF
+#  define T_EXP exp
+#  define T_SQRT sqrt
+#endif
 
 /** -----------------------------------------------------------------
  ** @internal
@@ -132,7 +561,8 @@ pixel <em>parent(x, y)</em> that achieves the minimum distance in
  **
  ** @param I    input image buffer
  ** @param N1   size of the first dimension of the image
- ** @param N2   size of the second dimension of the image
+ ** @param ps   pixel stride (distance between consecutive pixels)
+ ** @param cs   channel stride (distance between the channels of a pixel)
  ** @param K    number of channels
  ** @param i1   first dimension index of the first pixel to compare
  ** @param i2   second dimension of the first pixel
@@ -147,13 +577,13 @@ pixel <em>parent(x, y)</em> that achieves the minimum distance in
  **/
 
 VL_INLINE
-vl_qs_type
-vl_quickshift_distance(vl_qs_type const * I, 
-         int N1, int N2, int K,
+T
+VL_XCAT(_vl_quickshift_distance_, SFX)(T const * I, 
+         int N1, int ps, int cs, int K,
          int i1, int i2,
          int j1, int j2) 
 {
-  vl_qs_type dist = 0 ;
+  T dist = 0 ;
   int d1 = j1 - i1 ;
   int d2 = j2 - i2 ;
   int k ;
@@ -161,9 +591,34 @@ vl_quickshift_distance(vl_qs_type const * I,
   /* For k = 0...K-1, d+= L2 distance between I(i1,i2,k) and 
    * I(j1,j2,k) */
   for (k = 0 ; k < K ; ++k) {
-    vl_qs_type d = 
-      I [i1 + N1 * i2 + (N1*N2) * k] - 
-      I [j1 + N1 * j2 + (N1*N2) * k] ;
+    T d = 
+      I [(i1 + N1 * i2) * ps + cs * k] - 
+      I [(j1 + N1 * j2) * ps + cs * k] ;
+    dist += d*d ;
+  }
+  return dist ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Computes the accumulated channel L2 distance between i,j
+ **
+ ** Same as ::_vl_quickshift_distance_f (_d) without the spatial term.
+ **/
+
+VL_INLINE
+T
+VL_XCAT(_vl_quickshift_color_distance_, SFX)(T const * I, 
+         int N1, int ps, int cs, int K,
+         int i1, int i2,
+         int j1, int j2) 
+{
+  T dist = 0 ;
+  int k ;
+  for (k = 0 ; k < K ; ++k) {
+    T d = 
+      I [(i1 + N1 * i2) * ps + cs * k] - 
+      I [(j1 + N1 * j2) * ps + cs * k] ;
     dist += d*d ;
   }
   return dist ;
@@ -176,7 +631,8 @@ vl_quickshift_distance(vl_qs_type const * I,
  ** 
  ** @param I    input image buffer
  ** @param N1   size of the first dimension of the image
- ** @param N2   size of the second dimension of the image
+ ** @param ps   pixel stride (distance between consecutive pixels)
+ ** @param cs   channel stride (distance between the channels of a pixel)
  ** @param K    number of channels
  ** @param i1   first dimension index of the first pixel to compare
  ** @param i2   second dimension of the first pixel
@@ -191,87 +647,107 @@ vl_quickshift_distance(vl_qs_type const * I,
  **/
 
 VL_INLINE
-vl_qs_type
-vl_quickshift_inner(vl_qs_type const * I, 
-      int N1, int N2, int K,
+T
+VL_XCAT(_vl_quickshift_inner_, SFX)(T const * I, 
+      int N1, int ps, int cs, int K,
       int i1, int i2,
       int j1, int j2) 
 {
-  vl_qs_type ker = 0 ;
+  T ker = 0 ;
   int k ;
   ker += i1*j1 + i2*j2 ;
   for (k = 0 ; k < K ; ++k) {
     ker += 
-      I [i1 + N1 * i2 + (N1*N2) * k] *
-      I [j1 + N1 * j2 + (N1*N2) * k] ;
+      I [(i1 + N1 * i2) * ps + cs * k] *
+      I [(j1 + N1 * j2) * ps + cs * k] ;
   }
   return ker ;
 }
 
 /** -----------------------------------------------------------------
- ** @brief Create a quick shift object
- ** @param image
- ** @param height
- ** @param width
- ** @param channels
- **
- ** @return New quick shift object.
+ ** @internal
+ ** @brief Work of one thread: the pixels [i1begin, i1end) x [i2begin, i2end)
  **/
- 
-VL_EXPORT
-VlQS *
-vl_quickshift_new(vl_qs_type const * image, int height, int width,
-                       int channels)
-{
-  VlQS * q = vl_malloc(sizeof(VlQS));
-
-  q->image    = (vl_qs_type *)image;
-  q->height   = height;
-  q->width    = width;
-  q->channels = channels;
 
-  q->medoid   = VL_FALSE;
-  q->tau      = VL_MAX(height,width)/50;
-  q->sigma    = VL_MAX(2, q->tau/3);
+typedef struct
+{
+  VlQS * q ;
+  T * M ;       /**< medoid shift votes (NULL for quick shift) */
+  T * n ;       /**< medoid shift self inner products (NULL for quick shift) */
+  int R ;       /**< density window radius */
+  int tR ;      /**< parent search window radius */
+  T const * spatialWeights ; /**< exp(-(d1^2+d2^2)/(2 sigma^2)) for the (2R+1)^2 window offsets */
+  T const * expTable ;       /**< samples of exp(-x) (NULL to call exp) */
+  VL_XCAT(_VlQSDensityRow_, SFX) densityRow ; /**< SIMD density kernel (NULL for none) */
+  VL_XCAT(_VlQSParentsRow_, SFX) parentsRow ; /**< SIMD parents kernel (NULL for none) */
+  VL_XCAT(_VlQSMedoidDensityRow_, SFX) medoidDensityRow ; /**< SIMD medoid shift density kernel (NULL for none) */
+  VL_XCAT(_VlQSMedoidParentsRow_, SFX) medoidParentsRow ; /**< SIMD medoid shift parents kernel (NULL for none) */
+  int const * offsets ;      /**< parent search offsets (d1, d2), nearest first */
+  int numOffsets ;
+  int lanes ;                /**< pixels per call of the SIMD kernels */
+  T const * planar ;         /**< planar image read by the SIMD kernels */
+  vl_size planeStride ;      /**< distance between the channels of @c planar */
+  int i1begin ;
+  int i1end ;
+  int i2begin ;
+  int i2end ;
+} VL_XCAT(_VlQSBlock_, SFX) ;
 
-  q->dists    = vl_calloc(height*width, sizeof(vl_qs_type));
-  q->parents  = vl_calloc(height*width, sizeof(int)); 
-  q->density  = vl_calloc(height*width, sizeof(vl_qs_type)) ;
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Range of a column handled by a SIMD kernel
+ ** @param block block.
+ ** @param radius window radius of the kernel.
+ ** @param begin  first pixel (output).
+ ** @param end    one past the last pixel (output).
+ **
+ ** The pixels of the block whose windows fit in the image along the
+ ** first dimension, rounded down to a multiple of the number of lanes.
+ ** The range is empty if there are no SIMD kernels.
+ **/
 
-  return q;
+static void
+VL_XCAT(_vl_quickshift_simd_range_, SFX)(VL_XCAT(_VlQSBlock_, SFX) const * block,
+                                         int radius, int * begin, int * end)
+{
+  int N1 = block->q->height ;
+  int first = VL_MAX(radius, block->i1begin) ;
+  int count = VL_MIN(N1 - radius, block->i1end) - first ;
+  *begin = first ;
+  *end = first ;
+  if (block->lanes > 0 && count >= block->lanes) {
+    *end = first + count - count % block->lanes ;
+  }
 }
 
 /** -----------------------------------------------------------------
- ** @brief Create a quick shift objet
- ** @param q quick shift object.
+ ** @internal
+ ** @brief Density (and medoid shift votes) of the pixels of a block
+ ** @param arg block (::_VlQSBlock_f or ::_VlQSBlock_d).
+ **
+ ** Each pixel only writes its own entries of E, M and n, so blocks
+ ** can run concurrently.
  **/
 
-VL_EXPORT
-void vl_quickshift_process(VlQS * q)
+static void *
+VL_XCAT(_vl_quickshift_density_, SFX)(void * arg)
 {
-  vl_qs_type const *I = q->image;
-  int        *parents = q->parents;
-  vl_qs_type *E = q->density;
-  vl_qs_type *dists = q->dists; 
-  vl_qs_type *M = 0, *n = 0 ;
-  vl_qs_type sigma = q->sigma ;
-  vl_qs_type tau = q->tau;
-  vl_qs_type tau2 = tau*tau;
-  
-  int K = q->channels, d;
-  int N1 = q->height, N2 = q->width;
-  int i1,i2, j1,j2, R, tR;
-
-  d = 2 + K ; /* Total dimensions include spatial component (x,y) */
+  VL_XCAT(_VlQSBlock_, SFX) * block = (VL_XCAT(_VlQSBlock_, SFX) *) arg ;
+  VlQS * q = block->q ;
+  T const *I = (T const *) q->image;
+  T *E = (T *) q->density;
+  T *M = block->M, *n = block->n ;
+  T sigma = (T) q->sigma ;
+  T const *spatialWeights = block->spatialWeights ;
+  T const *expTable = block->expTable ;
+  T scale = 1 / (2*sigma*sigma) ;
 
-  if (q->medoid) { /* n and M are only used in mediod shift */
-    M = (vl_qs_type *) vl_calloc(N1*N2*d, sizeof(vl_qs_type)) ;
-    n = (vl_qs_type *) vl_calloc(N1*N2,   sizeof(vl_qs_type)) ;
-  }
+  int K = q->channels ;
+  int N1 = q->height, N2 = q->width;
+  int ps = q->pixelStride, cs = q->channelStride ;
+  int R = block->R ;
+  int i1,i2, j1,j2 ;
 
-  R = (int) ceil (3 * sigma) ;
-  tR = (int) ceil (tau) ;
-  
   /* -----------------------------------------------------------------
    *                                                                 n 
    * -------------------------------------------------------------- */
@@ -280,11 +756,11 @@ void vl_quickshift_process(VlQS * q)
    * image with itself
    */
   if (n) { 
-    for (i2 = 0 ; i2 < N2 ; ++ i2) {
-      for (i1 = 0 ; i1 < N1 ; ++ i1) {        
-        n [i1 + N1 * i2] = vl_quickshift_inner(I,N1,N2,K,
-                                               i1,i2,
-                                               i1,i2) ;
+    for (i2 = block->i2begin ; i2 < block->i2end ; ++ i2) {
+      for (i1 = block->i1begin ; i1 < block->i1end ; ++ i1) {        
+        n [i1 + N1 * i2] = VL_XCAT(_vl_quickshift_inner_, SFX)(I,N1,ps,cs,K,
+                                                                i1,i2,
+                                                                i1,i2) ;
       }
     }
   }
@@ -304,21 +780,52 @@ void vl_quickshift_process(VlQS * q)
      0 = dissimilar to everything, windowsize = identical
   */
   
-  for (i2 = 0 ; i2 < N2 ; ++ i2) {
-    for (i1 = 0 ; i1 < N1 ; ++ i1) {
+  for (i2 = block->i2begin ; i2 < block->i2end ; ++ i2) {
+    int simdBegin = 0, simdEnd = 0 ;
+
+    /* The interior of the column goes through the SIMD kernel */
+    VL_XCAT(_vl_quickshift_simd_range_, SFX)(block, R, &simdBegin, &simdEnd) ;
+    if (simdEnd > simdBegin) {
+      if (M) {
+        block->medoidDensityRow(block->planar, block->planeStride, N1, N2, K, R,
+                                spatialWeights, expTable, scale,
+                                simdBegin, simdEnd, i2, E, M) ;
+      } else {
+        block->densityRow(block->planar, block->planeStride, N1, N2, K, R,
+                          spatialWeights, expTable, scale,
+                          simdBegin, simdEnd, i2, E) ;
+      }
+    }
+
+    for (i1 = block->i1begin ; i1 < block->i1end ; ++ i1) {
       
       int j1min = VL_MAX(i1 - R, 0   ) ;
       int j1max = VL_MIN(i1 + R, N1-1) ;
       int j2min = VL_MAX(i2 - R, 0   ) ;
       int j2max = VL_MIN(i2 + R, N2-1) ;      
+
+      if (i1 >= simdBegin && i1 < simdEnd) continue ;
+
+      /* The object may have processed another image before */
+      E [i1 + N1 * i2] = 0 ;
       
       /* For each pixel in the window compute the distance between it and the
-       * source pixel */
+       * source pixel.
+       * exp(-Dij/(2 sigma^2)) factors into a spatial weight, which only
+       * depends on the offset j - i and is read from a table, and a color
+       * weight. */
       for (j2 = j2min ; j2 <= j2max ; ++ j2) {
+        T const * spatialRow = spatialWeights + (2*R+1) * (j2 - i2 + R) + R ;
         for (j1 = j1min ; j1 <= j1max ; ++ j1) {
-          vl_qs_type Dij = vl_quickshift_distance(I,N1,N2,K, i1,i2, j1,j2) ;          
+          T Cij, colorWeight, Fij ;
+          /* Offsets not drawn by a sampled density have no weight */
+          if (spatialRow [j1 - i1] == 0) continue ;
+          Cij = VL_XCAT(_vl_quickshift_color_distance_, SFX)(I,N1,ps,cs,K, i1,i2, j1,j2) ;          
+          colorWeight = expTable ?
+            VL_XCAT(_vl_quickshift_table_exp_, SFX)(expTable, Cij * scale) :
+            T_EXP(- Cij * scale) ;
           /* Make distance a similarity */ 
-          vl_qs_type Fij = - exp(- Dij / (2*sigma*sigma)) ;
+          Fij = - spatialRow [j1 - i1] * colorWeight ;
 
           /* E is E_i above */
           E [i1 + N1 * i2] -= Fij ;
@@ -330,7 +837,7 @@ void vl_quickshift_process(VlQS * q)
             M [i1 + N1*i2 + (N1*N2) * 1] += j2 * Fij ;
             for (k = 0 ; k < K ; ++k) {
               M [i1 + N1*i2 + (N1*N2) * (k+2)] += 
-                I [j1 + N1*j2 + (N1*N2) * k] * Fij ;
+                I [(j1 + N1*j2) * ps + cs * k] * Fij ;
             }
           } 
           
@@ -339,6 +846,99 @@ void vl_quickshift_process(VlQS * q)
 
     }  /* i1 */
   } /* i2 */
+
+  return NULL ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Approximate density of all the pixels
+ ** @param q quick shift object.
+ ** @param arena arena the lattice is allocated from (NULL for none).
+ ** @param o1 first coordinate of the image in the features.
+ ** @param o2 second coordinate of the image in the features.
+ **
+ ** Filters the joint spatial and color features with a Gaussian of
+ ** standard deviation @c sigma on a permutohedral lattice (see
+ ** ::VlLattice) and writes the result to the density. The cost per pixel
+ ** is O(d^2) in the feature dimension d = 2 + channels and does not
+ ** depend on the kernel size.
+ **/
+
+static void
+VL_XCAT(_vl_quickshift_approximate_density_, SFX)(VlQS * q, VlArena * arena, int o1, int o2)
+{
+  T const *I = (T const *) q->image;
+  T *E = (T *) q->density;
+  double sigma = q->sigma ;
+  int K = q->channels ;
+  int N1 = q->height, N2 = q->width;
+  int ps = q->pixelStride, cs = q->channelStride ;
+  int i1, i2, k ;
+  double * feature ;
+  VlLattice * lattice ;
+
+  /* Nothing else lives in the arena, so it can start over. The lattice
+   * then takes its memory straight from it, without the allocation
+   * hooks or any other global state. */
+  if (arena) {
+    vl_arena_reset(arena) ;
+    feature = vl_arena_malloc(arena, (K + 2) * sizeof(double)) ;
+  } else {
+    feature = vl_malloc((K + 2) * sizeof(double)) ;
+  }
+  lattice = vl_lattice_new_with_arena(arena, K + 2, N1*N2) ;
+
+  for (i2 = 0 ; i2 < N2 ; ++ i2) {
+    for (i1 = 0 ; i1 < N1 ; ++ i1) {
+      feature [0] = (i1 + o1) / sigma ;
+      feature [1] = (i2 + o2) / sigma ;
+      for (k = 0 ; k < K ; ++k) {
+        feature [k+2] = I [(i1 + N1*i2) * ps + cs * k] / sigma ;
+      }
+      vl_lattice_splat(lattice, i1 + N1 * i2, feature, 1.0) ;
+    }
+  }
+
+  vl_lattice_blur(lattice) ;
+
+  for (i2 = 0 ; i2 < N1*N2 ; ++ i2) {
+    E [i2] = (T) vl_lattice_slice(lattice, i2) ;
+  }
+
+  vl_lattice_delete(lattice) ;
+  if (! arena) {
+    vl_free(feature) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Parents of the pixels of a block
+ ** @param arg block (::_VlQSBlock_f or ::_VlQSBlock_d).
+ **
+ ** Reads the density of the whole image, so it must only run once
+ ** every block has finished ::_vl_quickshift_density_f (or _d).
+ **/
+
+static void *
+VL_XCAT(_vl_quickshift_neighbors_, SFX)(void * arg)
+{
+  VL_XCAT(_VlQSBlock_, SFX) * block = (VL_XCAT(_VlQSBlock_, SFX) *) arg ;
+  VlQS * q = block->q ;
+  T const *I = (T const *) q->image;
+  int        *parents = q->parents;
+  T *E = (T *) q->density;
+  T *dists = (T *) q->dists; 
+  T *M = block->M, *n = block->n ;
+  T tau = (T) q->tau;
+  T tau2 = tau*tau;
+
+  int K = q->channels ;
+  int N1 = q->height, N2 = q->width;
+  int ps = q->pixelStride, cs = q->channelStride ;
+  int R = block->R, tR = block->tR ;
+  int i1,i2, j1,j2 ;
   
   /* -----------------------------------------------------------------
    *                                               Find best neighbors
@@ -352,30 +952,41 @@ void vl_quickshift_process(VlQS * q)
     */
     
     /* medoid shift */
-    for (i2 = 0 ; i2 < N2 ; ++i2) {
-      for (i1 = 0 ; i1 < N1 ; ++i1) {
+    for (i2 = block->i2begin ; i2 < block->i2end ; ++i2) {
+      int simdBegin = 0, simdEnd = 0 ;
+
+      /* The interior of the column goes through the SIMD kernel */
+      VL_XCAT(_vl_quickshift_simd_range_, SFX)(block, R, &simdBegin, &simdEnd) ;
+      if (simdEnd > simdBegin) {
+        block->medoidParentsRow(block->planar, block->planeStride, N1, N2, K, R,
+                                E, M, n, simdBegin, simdEnd, i2, parents, dists) ;
+      }
+
+      for (i1 = block->i1begin ; i1 < block->i1end ; ++i1) {
         
-        vl_qs_type sc_best = 0  ;
+        T sc_best = 0  ;
         /* j1/j2 best are the best indicies for each i */
-        vl_qs_type j1_best = i1 ;
-        vl_qs_type j2_best = i2 ; 
+        int j1_best = i1 ;
+        int j2_best = i2 ; 
         
         int j1min = VL_MAX(i1 - R, 0   ) ;
         int j1max = VL_MIN(i1 + R, N1-1) ;
         int j2min = VL_MAX(i2 - R, 0   ) ;
         int j2max = VL_MIN(i2 + R, N2-1) ;      
+
+        if (i1 >= simdBegin && i1 < simdEnd) continue ;
         
         for (j2 = j2min ; j2 <= j2max ; ++ j2) {
           for (j1 = j1min ; j1 <= j1max ; ++ j1) {            
             
-            vl_qs_type Qij = - n [j1 + j2 * N1] * E [i1 + i2 * N1] ;
+            T Qij = - n [j1 + j2 * N1] * E [i1 + i2 * N1] ;
             int k ;
 
             Qij -= 2 * j1 * M [i1 + i2 * N1 + (N1*N2) * 0] ;
             Qij -= 2 * j2 * M [i1 + i2 * N1 + (N1*N2) * 1] ;
             for (k = 0 ; k < K ; ++k) {
               Qij -= 2 * 
-                I [j1 + j2 * N1 + (N1*N2) * k] *
+                I [(j1 + j2 * N1) * ps + cs * k] *
                 M [i1 + i2 * N1 + (N1*N2) * (k + 2)] ;
             }
             
@@ -401,28 +1012,47 @@ void vl_quickshift_process(VlQS * q)
      * density (E). If there is no j s.t. Ej > Ei, then dists_i == inf (a root
      * node in one of the trees of merges).
      */
-    for (i2 = 0 ; i2 < N2 ; ++i2) {
-      for (i1 = 0 ; i1 < N1 ; ++i1) {
-        
-        vl_qs_type E0 = E [i1 + N1 * i2] ;
-        vl_qs_type d_best = VL_QS_INF ;
-        vl_qs_type j1_best = i1   ;
-        vl_qs_type j2_best = i2   ; 
+    for (i2 = block->i2begin ; i2 < block->i2end ; ++i2) {
+      int simdBegin = 0, simdEnd = 0 ;
+
+      /* The interior of the column goes through the SIMD kernel */
+      if (block->parentsRow) {
+        VL_XCAT(_vl_quickshift_simd_range_, SFX)(block, tR, &simdBegin, &simdEnd) ;
+        if (simdEnd > simdBegin) {
+          block->parentsRow(block->planar, block->planeStride, N1, N2, K, tR,
+                            tau2, block->offsets, block->numOffsets, E,
+                            simdBegin, simdEnd, i2, parents, dists) ;
+        }
+      }
+
+      for (i1 = block->i1begin ; i1 < block->i1end ; ++i1) {
         
-        int j1min = VL_MAX(i1 - tR, 0   ) ;
-        int j1max = VL_MIN(i1 + tR, N1-1) ;
-        int j2min = VL_MAX(i2 - tR, 0   ) ;
-        int j2max = VL_MIN(i2 + tR, N2-1) ;      
+        T E0 = E [i1 + N1 * i2] ;
+        T d_best = T_INF ;
+        int j1_best = i1   ;
+        int j2_best = i2   ; 
+        int o ;
+
+        if (i1 >= simdBegin && i1 < simdEnd) continue ;
         
-        for (j2 = j2min ; j2 <= j2max ; ++ j2) {
-          for (j1 = j1min ; j1 <= j1max ; ++ j1) {            
-            if (E [j1 + N1 * j2] > E0) {
-              vl_qs_type Dij = vl_quickshift_distance(I,N1,N2,K, i1,i2, j1,j2) ;
-              if (Dij <= tau2 && Dij < d_best) {
-                d_best = Dij ;
-                j1_best = j1 ;
-                j2_best = j2 ;
-              }
+        /* The offsets come nearest first, and Dij is at least the spatial
+         * distance: once that exceeds d_best no farther pixel can win. */
+        for (o = 0 ; o < block->numOffsets ; ++o) {
+          int d1 = block->offsets [2*o] ;
+          int d2 = block->offsets [2*o+1] ;
+          j1 = i1 + d1 ;
+          j2 = i2 + d2 ;
+          if ((T) (d1*d1 + d2*d2) > d_best) break ;
+          if (j1 < 0 || j1 >= N1 || j2 < 0 || j2 >= N2) continue ;
+          if (E [j1 + N1 * j2] > E0) {
+            T Dij = VL_XCAT(_vl_quickshift_distance_, SFX)(I,N1,ps,cs,K, i1,i2, j1,j2) ;
+            /* Ties go to the smaller index, i.e. the first pixel of the window scan */
+            if (Dij <= tau2 &&
+                (Dij < d_best ||
+                 (Dij == d_best && j1 + N1 * j2 < j1_best + N1 * j2_best))) {
+              d_best = Dij ;
+              j1_best = j1 ;
+              j2_best = j2 ;
             }
           }
         }
@@ -431,36 +1061,472 @@ void vl_quickshift_process(VlQS * q)
         /* dists_i is the minimal distance, inf implies no Ej > Ei within
          * distance tau from the point */
         parents [i1 + N1 * i2] = j1_best + N1 * j2_best ;
-        dists[i1 + N1 * i2] = sqrt(d_best) ;
+        dists[i1 + N1 * i2] = T_SQRT(d_best) ;
       }
     }  
   }
-  
-  if (M) vl_free(M) ;
-  if (n) vl_free(n) ;
+
+  return NULL ;
 }
 
 /** -----------------------------------------------------------------
- ** @brief Delete quick shift object
+ ** @internal
+ ** @brief Select the SIMD kernels for this CPU
+ ** @param densityRow density kernel (output).
+ ** @param parentsRow parents kernel (output).
+ ** @param medoidDensityRow medoid shift density kernel (output).
+ ** @param medoidParentsRow medoid shift parents kernel (output).
+ ** @return the number of pixels per kernel call, or 0 (and NULL kernels)
+ **         if SIMD is disabled (::vl_set_simd_enabled) or unavailable.
+ **
+ ** The widest instruction set supported by both the build and the CPU
+ ** wins. All the kernels give the same results as the scalar code.
+ **/
+
+static int
+VL_XCAT(_vl_quickshift_select_kernels_, SFX)(VL_XCAT(_VlQSDensityRow_, SFX) * densityRow,
+                                             VL_XCAT(_VlQSParentsRow_, SFX) * parentsRow,
+                                             VL_XCAT(_VlQSMedoidDensityRow_, SFX) * medoidDensityRow,
+                                             VL_XCAT(_VlQSMedoidParentsRow_, SFX) * medoidParentsRow)
+{
+  *densityRow = NULL ;
+  *parentsRow = NULL ;
+  *medoidDensityRow = NULL ;
+  *medoidParentsRow = NULL ;
+  if (! vl_get_simd_enabled()) {
+    return 0 ;
+  }
+#ifndef VL_DISABLE_AVX512
+  if (vl_cpu_has_avx512f()) {
+    *densityRow = VL_XCAT(_vl_quickshift_density_row_avx512_, SFX) ;
+    *parentsRow = VL_XCAT(_vl_quickshift_parents_row_avx512_, SFX) ;
+    *medoidDensityRow = VL_XCAT(_vl_quickshift_medoid_density_row_avx512_, SFX) ;
+    *medoidParentsRow = VL_XCAT(_vl_quickshift_medoid_parents_row_avx512_, SFX) ;
+    return 64 / sizeof(T) ;
+  }
+#endif
+#ifndef VL_DISABLE_AVX2
+  if (vl_cpu_has_avx2()) {
+    *densityRow = VL_XCAT(_vl_quickshift_density_row_avx2_, SFX) ;
+    *parentsRow = VL_XCAT(_vl_quickshift_parents_row_avx2_, SFX) ;
+    *medoidDensityRow = VL_XCAT(_vl_quickshift_medoid_density_row_avx2_, SFX) ;
+    *medoidParentsRow = VL_XCAT(_vl_quickshift_medoid_parents_row_avx2_, SFX) ;
+    return 32 / sizeof(T) ;
+  }
+#endif
+#ifndef VL_DISABLE_SSE2
+  if (vl_cpu_has_sse2()) {
+    *densityRow = VL_XCAT(_vl_quickshift_density_row_sse2_, SFX) ;
+    *parentsRow = VL_XCAT(_vl_quickshift_parents_row_sse2_, SFX) ;
+    *medoidDensityRow = VL_XCAT(_vl_quickshift_medoid_density_row_sse2_, SFX) ;
+    *medoidParentsRow = VL_XCAT(_vl_quickshift_medoid_parents_row_sse2_, SFX) ;
+    return 16 / sizeof(T) ;
+  }
+#endif
+  return 0 ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Sample the density window
+ ** @param spatialWeights the (2R+1)^2 spatial weights of the window,
+ **        replaced by those of the sample.
+ ** @param R window radius.
+ ** @param numSamples number of draws.
+ ** @param seed seed of the random number generator.
+ ** @param cdf space for (2R+1)^2 values.
+ **
+ ** Draws @a numSamples offsets with replacement, with probabilities
+ ** proportional to their spatial weights, and weights each offset by
+ ** the number of times it was drawn times S / @a numSamples, S being
+ ** the sum of the spatial weights. The density is then an unbiased
+ ** estimate of the exact one. The offsets never drawn get weight 0.
+ **/
+
+static void
+VL_XCAT(_vl_quickshift_sample_weights_, SFX)(T * spatialWeights, int R, int numSamples,
+                                             vl_uint32 seed, double * cdf)
+{
+  int size = (2*R+1) * (2*R+1) ;
+  double total = 0 ;
+  VlRand rand ;
+  int o, n ;
+
+  for (o = 0 ; o < size ; ++o) {
+    total += spatialWeights [o] ;
+    cdf [o] = total ;
+    spatialWeights [o] = 0 ;
+  }
+
+  vl_rand_seed(&rand, seed) ;
+  for (n = 0 ; n < numSamples ; ++n) {
+    /* The first offset whose cumulative weight exceeds u */
+    double u = vl_rand_res53(&rand) * total ;
+    int first = 0, last = size - 1 ;
+    while (first < last) {
+      int middle = (first + last) / 2 ;
+      if (cdf [middle] > u) {
+        last = middle ;
+      } else {
+        first = middle + 1 ;
+      }
+    }
+    spatialWeights [first] += 1 ;
+  }
+
+  for (o = 0 ; o < size ; ++o) {
+    spatialWeights [o] *= (T) (total / numSamples) ;
+  }
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Offsets of the parent search
+ ** @param tR   window radius.
+ ** @param tau2 squared maximum distance.
+ ** @param offsets space for (2 tR + 1)^2 offsets (d1, d2) (output).
+ ** @return the number of offsets.
+ **
+ ** The offsets of the window whose spatial distance alone does not
+ ** exceed @a tau2, except (0, 0), sorted nearest first
+ ** (::_vl_quickshift_compare_offsets).
+ **/
+
+static int
+VL_XCAT(_vl_quickshift_search_offsets_, SFX)(int tR, T tau2, int * offsets)
+{
+  int numOffsets = 0 ;
+  int d1, d2 ;
+  for (d2 = -tR ; d2 <= tR ; ++ d2) {
+    for (d1 = -tR ; d1 <= tR ; ++ d1) {
+      if ((d1 || d2) && (T) (d1*d1 + d2*d2) <= tau2) {
+        offsets [2*numOffsets] = d1 ;
+        offsets [2*numOffsets+1] = d2 ;
+        ++ numOffsets ;
+      }
+    }
+  }
+  qsort(offsets, numOffsets, 2 * sizeof(int), _vl_quickshift_compare_offsets) ;
+  return numOffsets ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Work of one thread in tiled mode: every @c step-th tile from @c first
+ **/
+
+typedef struct
+{
+  VL_XCAT(_VlQSBlock_, SFX) block ; /**< settings of the blocks of the tiles */
+  T * image ;     /**< planar copy of the frame of a tile */
+  T * density ;   /**< density of the frame */
+  int * parents ; /**< parents of the frame, as indices into the frame */
+  T * dists ;     /**< distances of the frame */
+  int first ;
+  int step ;
+} VL_XCAT(_VlQSTileWorker_, SFX) ;
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Parents of the pixels of the tiles of a worker
+ ** @param arg worker (::_VlQSTileWorker_f or ::_VlQSTileWorker_d).
+ **
+ ** The parent search of a tile reads the density of the tile plus a
+ ** @c tR halo, which reads the image of the tile plus a @c tR + @c R
+ ** halo (its frame). The frame is copied to the buffers of the worker
+ ** and processed as an image of its own: a window clipped to the frame
+ ** is clipped to the image too, so each pixel gets the density,
+ ** parent and distance it gets without tiles. The parents are then
+ ** mapped back to indices into the image.
+ **/
+
+static void *
+VL_XCAT(_vl_quickshift_tiles_, SFX)(void * arg)
+{
+  VL_XCAT(_VlQSTileWorker_, SFX) * worker = (VL_XCAT(_VlQSTileWorker_, SFX) *) arg ;
+  VlQS * q = worker->block.q ;
+  T const *I = (T const *) q->image;
+  int *parents = q->parents;
+  T *dists = (T *) q->dists;
+
+  int K = q->channels ;
+  int N1 = q->height, N2 = q->width;
+  int ps = q->pixelStride, cs = q->channelStride ;
+  int S = q->tileSize ;
+  int R = worker->block.R, tR = worker->block.tR ;
+  int numTiles1 = (N1 + S - 1) / S ;
+  int numTiles = numTiles1 * ((N2 + S - 1) / S) ;
+  int t, i1, i2, k ;
+
+  for (t = worker->first ; t < numTiles ; t += worker->step) {
+    VlQS frame = *q ;
+    VL_XCAT(_VlQSBlock_, SFX) block = worker->block ;
+
+    /* The tile [a1,b1) x [a2,b2) and its frame, of size F1 x F2 at (o1,o2) */
+    int a1 = (t % numTiles1) * S, b1 = VL_MIN(a1 + S, N1) ;
+    int a2 = (t / numTiles1) * S, b2 = VL_MIN(a2 + S, N2) ;
+    int o1 = VL_MAX(a1 - tR - R, 0), o2 = VL_MAX(a2 - tR - R, 0) ;
+    int F1 = VL_MIN(b1 + tR + R, N1) - o1 ;
+    int F2 = VL_MIN(b2 + tR + R, N2) - o2 ;
+
+    for (i2 = 0 ; i2 < F2 ; ++ i2) {
+      for (i1 = 0 ; i1 < F1 ; ++ i1) {
+        for (k = 0 ; k < K ; ++k) {
+          worker->image [(vl_size) F1*F2 * k + i1 + F1 * i2] =
+            I [((i1 + o1) + N1 * (i2 + o2)) * ps + cs * k] ;
+        }
+      }
+    }
+
+    frame.image = worker->image ;
+    frame.height = F1 ;
+    frame.width = F2 ;
+    frame.pixelStride = 1 ;
+    frame.channelStride = F1 * F2 ;
+    frame.density = worker->density ;
+    frame.parents = worker->parents ;
+    frame.dists = worker->dists ;
+    block.q = &frame ;
+    block.planar = worker->image ;
+    block.planeStride = (vl_size) F1 * F2 ;
+
+    /* Density of the tile and its tR halo */
+    if (q->approximateDensity) {
+      /* The lattice is not invariant to translations, so the frame keeps
+       * the coordinates of the image */
+      VL_XCAT(_vl_quickshift_approximate_density_, SFX)(&frame, NULL, o1, o2) ;
+    } else {
+      block.i1begin = VL_MAX(a1 - tR, 0) - o1 ;
+      block.i1end = VL_MIN(b1 + tR, N1) - o1 ;
+      block.i2begin = VL_MAX(a2 - tR, 0) - o2 ;
+      block.i2end = VL_MIN(b2 + tR, N2) - o2 ;
+      VL_XCAT(_vl_quickshift_density_, SFX)(&block) ;
+    }
+
+    /* Parents of the tile */
+    block.i1begin = a1 - o1 ;
+    block.i1end = b1 - o1 ;
+    block.i2begin = a2 - o2 ;
+    block.i2end = b2 - o2 ;
+    VL_XCAT(_vl_quickshift_neighbors_, SFX)(&block) ;
+
+    for (i2 = a2 ; i2 < b2 ; ++ i2) {
+      for (i1 = a1 ; i1 < b1 ; ++ i1) {
+        int i = (i1 - o1) + F1 * (i2 - o2) ;
+        int parent = worker->parents [i] ;
+        parents [i1 + N1 * i2] = (parent % F1 + o1) + N1 * (parent / F1 + o2) ;
+        dists [i1 + N1 * i2] = worker->dists [i] ;
+      }
+    }
+  }
+
+  return NULL ;
+}
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Process an image (typed implementation of ::vl_quickshift_process)
  ** @param q quick shift object.
+ ** @param searchOnly keep the density of the last call and only search
+ **        the parents (::vl_quickshift_process_parents); the density
+ **        must be there, without tiles or medoid shift.
+ **
+ ** The image columns are split into one contiguous block per thread.
+ ** All blocks compute their density, then (once every thread is done)
+ ** their parents. Each pixel is computed by the same sequence of
+ ** operations whatever the number of threads, so the results do not
+ ** depend on it.
+ **
+ ** In tiled mode each thread instead processes every @c numBlocks-th
+ ** tile, density and parents together (::_vl_quickshift_tiles_f), with
+ ** buffers for one tile frame.
  **/
 
-void vl_quickshift_delete(VlQS * q)
+static void
+VL_XCAT(_vl_quickshift_process_, SFX)(VlQS * q, vl_bool searchOnly)
 {
-  if (q) {
-    if (q->parents) 
-    {
-      vl_free(q->parents);
+  VL_XCAT(_VlQSBlock_, SFX) * blocks = 0 ;
+  VL_XCAT(_VlQSTileWorker_, SFX) * workers = 0 ;
+  _VlQSThread * threads ;
+  VL_XCAT(_VlQSDensityRow_, SFX) densityRow ;
+  VL_XCAT(_VlQSParentsRow_, SFX) parentsRow ;
+  VL_XCAT(_VlQSMedoidDensityRow_, SFX) medoidDensityRow ;
+  VL_XCAT(_VlQSMedoidParentsRow_, SFX) medoidParentsRow ;
+  int lanes ;
+  T const *planar ;
+  vl_size planeStride ;
+  T *M = 0, *n = 0 ;
+  T *spatialWeights, *expTable = 0 ;
+  int *offsets ;
+  int numOffsets ;
+  T sigma = (T) q->sigma ;
+  T tau = (T) q->tau ;
+  int K = q->channels, d;
+  int N1 = q->height, N2 = q->width;
+  int R, tR, b, j1, j2 ;
+  int numBlocks = VL_MAX(1, VL_MIN(q->numThreads, N2)) ;
+  vl_bool tiled = q->tileSize > 0 && ! q->medoid ;
+  int F1 = 0, F2 = 0 ;
+  vl_size blocksSize, threadsSize, weightsSize, cdfSize, offsetsSize, tableSize, mSize, nSize ;
+  vl_size frameImageSize = 0, frameDensitySize = 0, frameParentsSize = 0 ;
+  char * scratch ;
+
+  d = 2 + K ; /* Total dimensions include spatial component (x,y) */
+
+  /* The window sizes do not depend on the precision */
+  R = (int) ceil (3 * q->sigma) ;
+  tR = (int) ceil (q->tau) ;
+
+  if (tiled) {
+    /* One worker per thread, with the buffers of the largest tile frame */
+    int numTiles = ((N1 + q->tileSize - 1) / q->tileSize) *
+                   ((N2 + q->tileSize - 1) / q->tileSize) ;
+    numBlocks = VL_MAX(1, VL_MIN(q->numThreads, numTiles)) ;
+    F1 = VL_MIN(q->tileSize + 2 * (tR + R), N1) ;
+    F2 = VL_MIN(q->tileSize + 2 * (tR + R), N2) ;
+    frameImageSize = VL_QS_SCRATCH_ALIGN((vl_size) F1*F2*K * sizeof(T)) ;
+    frameDensitySize = VL_QS_SCRATCH_ALIGN((vl_size) F1*F2 * sizeof(T)) ;
+    frameParentsSize = VL_QS_SCRATCH_ALIGN((vl_size) F1*F2 * sizeof(int)) ;
+    /* Nor does the object keep the density of the whole image */
+    if (q->density) {
+      vl_free(q->density) ;
+      q->density = NULL ;
     }
-    if (q->dists)   
-    {
-      vl_free(q->dists);
+  } else if (! q->density) {
+    q->density = vl_calloc((vl_size) N1*N2, sizeof(T)) ;
+  }
+
+  /* All the working memory comes from the scratch buffer of the object */
+  blocksSize = tiled ?
+    VL_QS_SCRATCH_ALIGN(numBlocks * sizeof(VL_XCAT(_VlQSTileWorker_, SFX))) :
+    VL_QS_SCRATCH_ALIGN(numBlocks * sizeof(VL_XCAT(_VlQSBlock_, SFX))) ;
+  threadsSize = VL_QS_SCRATCH_ALIGN(numBlocks * sizeof(_VlQSThread)) ;
+  weightsSize = VL_QS_SCRATCH_ALIGN((2*R+1) * (2*R+1) * sizeof(T)) ;
+  /* The approximate density of quick shift does not use the weights */
+  cdfSize = (q->densitySamples > 0 && q->densitySamples < (2*R+1) * (2*R+1) &&
+             ! (q->approximateDensity && ! q->medoid)) ?
+    VL_QS_SCRATCH_ALIGN((2*R+1) * (2*R+1) * sizeof(double)) : 0 ;
+  offsetsSize = VL_QS_SCRATCH_ALIGN((vl_size) (2*tR+1) * (2*tR+1) * 2 * sizeof(int)) ;
+  tableSize = q->expTable ? VL_QS_SCRATCH_ALIGN(VL_QS_EXP_TABLE_SIZE * sizeof(T)) : 0 ;
+  mSize = q->medoid ? VL_QS_SCRATCH_ALIGN((vl_size) N1*N2*d * sizeof(T)) : 0 ;
+  nSize = q->medoid ? VL_QS_SCRATCH_ALIGN((vl_size) N1*N2 * sizeof(T)) : 0 ;
+
+  /* The SIMD kernels read the channels of consecutive pixels from
+   * contiguous planes. The frames of the tiles are planar, but an
+   * interleaved image is left to the scalar code rather than copied */
+  lanes = VL_XCAT(_vl_quickshift_select_kernels_, SFX)(&densityRow, &parentsRow,
+                                                       &medoidDensityRow, &medoidParentsRow) ;
+  if (q->pixelStride != 1 && ! tiled) {
+    lanes = 0 ;
+    densityRow = NULL ;
+    parentsRow = NULL ;
+    medoidDensityRow = NULL ;
+    medoidParentsRow = NULL ;
+  }
+
+  scratch = _vl_quickshift_get_scratch(q, blocksSize + threadsSize + weightsSize + cdfSize + offsetsSize +
+                                          tableSize + mSize + nSize +
+                                          numBlocks * (frameImageSize + 2 * frameDensitySize +
+                                                       frameParentsSize)) ;
+  if (tiled) {
+    workers = (VL_XCAT(_VlQSTileWorker_, SFX) *) scratch ;
+  } else {
+    blocks = (VL_XCAT(_VlQSBlock_, SFX) *) scratch ;
+  }
+  scratch += blocksSize ;
+  threads = (_VlQSThread *) scratch ; scratch += threadsSize ;
+  spatialWeights = (T *) scratch ; scratch += weightsSize ;
+  offsets = (int *) scratch ; scratch += offsetsSize ;
+  if (q->expTable) {
+    expTable = (T *) scratch ; scratch += tableSize ;
+  }
+  if (q->medoid) { /* n and M are only used in mediod shift */
+    M = (T *) scratch ; scratch += mSize ;
+    n = (T *) scratch ; scratch += nSize ;
+    memset(M, 0, (vl_size) N1*N2*d * sizeof(T)) ;
+    memset(n, 0, (vl_size) N1*N2 * sizeof(T)) ;
+  }
+  planar = (T const *) q->image ;
+  planeStride = q->channelStride ;
+
+  /* Spatial factor of the density kernel for each window offset */
+  for (j2 = -R ; j2 <= R ; ++ j2) {
+    for (j1 = -R ; j1 <= R ; ++ j1) {
+      spatialWeights [(j1 + R) + (2*R+1) * (j2 + R)] =
+        T_EXP(- (T) (j1*j1 + j2*j2) / (2*sigma*sigma)) ;
     }
-    if (q->density) 
-    {
-      vl_free(q->density);
+  }
+  if (cdfSize) {
+    VL_XCAT(_vl_quickshift_sample_weights_, SFX)(spatialWeights, R, q->densitySamples,
+                                                 q->densitySeed, (double *) scratch) ;
+    scratch += cdfSize ;
+  }
+
+  numOffsets = VL_XCAT(_vl_quickshift_search_offsets_, SFX)(tR, tau*tau, offsets) ;
+
+  if (expTable) {
+    for (j1 = 0 ; j1 < VL_QS_EXP_TABLE_SIZE ; ++ j1) {
+      expTable [j1] = T_EXP(- (T) j1 / VL_QS_EXP_TABLE_STEPS) ;
     }
-    
-    vl_free(q);
   }
+
+  for (b = 0 ; b < numBlocks ; ++b) {
+    VL_XCAT(_VlQSBlock_, SFX) * block = tiled ? &workers[b].block : &blocks[b] ;
+    block->q = q ;
+    block->M = M ;
+    block->n = n ;
+    block->R = R ;
+    block->tR = tR ;
+    block->spatialWeights = spatialWeights ;
+    block->expTable = expTable ;
+    block->offsets = offsets ;
+    block->numOffsets = numOffsets ;
+    block->densityRow = densityRow ;
+    block->parentsRow = parentsRow ;
+    block->medoidDensityRow = medoidDensityRow ;
+    block->medoidParentsRow = medoidParentsRow ;
+    block->lanes = lanes ;
+    block->planar = planar ;
+    block->planeStride = planeStride ;
+    block->i1begin = 0 ;
+    block->i1end = N1 ;
+    block->i2begin = (int) (((vl_int64) N2 * b) / numBlocks) ;
+    block->i2end = (int) (((vl_int64) N2 * (b + 1)) / numBlocks) ;
+  }
+
+  if (tiled) {
+    for (b = 0 ; b < numBlocks ; ++b) {
+      workers[b].image = (T *) scratch ; scratch += frameImageSize ;
+      workers[b].density = (T *) scratch ; scratch += frameDensitySize ;
+      workers[b].dists = (T *) scratch ; scratch += frameDensitySize ;
+      workers[b].parents = (int *) scratch ; scratch += frameParentsSize ;
+      workers[b].first = b ;
+      workers[b].step = numBlocks ;
+    }
+    _vl_quickshift_run_blocks(workers, sizeof(VL_XCAT(_VlQSTileWorker_, SFX)), numBlocks,
+                              VL_XCAT(_vl_quickshift_tiles_, SFX), threads) ;
+    return ;
+  }
+
+  if (searchOnly) {
+    /* The density is that of the last call */
+  } else if (q->approximateDensity && ! q->medoid) {
+    VL_XCAT(_vl_quickshift_approximate_density_, SFX)(q, q->arena, 0, 0) ;
+  } else {
+    _vl_quickshift_run_blocks(blocks, sizeof(VL_XCAT(_VlQSBlock_, SFX)), numBlocks,
+                              VL_XCAT(_vl_quickshift_density_, SFX), threads) ;
+  }
+  _vl_quickshift_run_blocks(blocks, sizeof(VL_XCAT(_VlQSBlock_, SFX)), numBlocks,
+                            VL_XCAT(_vl_quickshift_neighbors_, SFX), threads) ;
 }
+
+#undef T
+#undef SFX
+#undef T_INF
+#undef T_EXP
+#undef T_SQRT
+#undef FLT
+#undef VL_QUICKSHIFT_INSTANTIATING
+
+/* VL_QUICKSHIFT_INSTANTIATING */
+#endif
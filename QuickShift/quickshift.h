@@ -16,34 +16,64 @@ GNU GPLv2, or (at your option) any later version.
 #define VL_QUICKSHIFT_H
 
 #include "generic.h"
+#include "arena.h"
 #include "mathop.h"
 
-/** @brief quick shift datatype */
+/** @brief quick shift datatype (double precision engine) */
 typedef double vl_qs_type ;
 
+/** @brief quick shift datatype (single precision engine) */
+typedef float vl_qs_type_f ;
+
 /** @brief quick shift infinity constant */
-#define VL_QS_INF VL_INFINITY_D /* Change to _F for float math */
+#define VL_QS_INF VL_INFINITY_D
+
+/** @brief quick shift infinity constant (single precision engine) */
+#define VL_QS_INF_F VL_INFINITY_F
 
 /** ------------------------------------------------------------------
  ** @brief quick shift results
  **
  ** This implements quick shift mode seeking.
+ **
+ ** The object computes either in double precision (::vl_quickshift_new)
+ ** or in single precision (::vl_quickshift_new_f). @c image, @c dists
+ ** and @c density have the type given by @c dataType.
+ **
+ ** Channel @c k of pixel <em>(i1, i2)</em> (@c i1 < @c height,
+ ** @c i2 < @c width) is read from
+ ** <code>image[(i1 + height * i2) * pixelStride + k * channelStride]</code>
+ ** (see ::vl_quickshift_set_layout). @c parents, @c dists and
+ ** @c density are indexed by <code>i1 + height * i2</code>.
  **/
 
 typedef struct _VlQS
 {
-  vl_qs_type *image ;   /**< height x width x channels feature image */
+  vl_type dataType ;    /**< ::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT */
+  void *image ;         /**< height x width x channels feature image */
   int height;           /**< height of the image */
   int width;            /**< width of the image */
   int channels;         /**< number of channels in the image */
+  int pixelStride;      /**< distance between consecutive pixels in @c image */
+  int channelStride;    /**< distance between the channels of a pixel in @c image */
 
   vl_bool medoid;
-  vl_qs_type sigma;
-  vl_qs_type tau;
+  int numThreads;       /**< number of threads used by ::vl_quickshift_process */
+  vl_bool expTable;     /**< approximate the color weights of the density from a table */
+  vl_bool approximateDensity; /**< approximate the density on a permutohedral lattice */
+  int densitySamples;   /**< window offsets sampled by the density (0 for all) */
+  vl_uint32 densitySeed; /**< seed of the sampled offsets */
+  int tileSize;         /**< side of the tiles of the tiled mode (0 to process the whole image) */
+  VlArena *arena;       /**< arena of the approximate density, reset for each image (not owned) */
+  double sigma;
+  double tau;
  
   int *parents ;
-  vl_qs_type *dists ;
-  vl_qs_type *density ;
+  void *dists ;
+  void *density ;
+
+  void *scratch ;       /**< working memory of ::vl_quickshift_process, kept between calls */
+  vl_size scratchSize ; /**< size of @c scratch in bytes */
 } VlQS ;
 
 /** @name Create and destroy
@@ -53,6 +83,10 @@ VL_EXPORT
 VlQS*  vl_quickshift_new (vl_qs_type const * im, int height, int width,
                           int channels);
 
+VL_EXPORT
+VlQS*  vl_quickshift_new_f (vl_qs_type_f const * im, int height, int width,
+                            int channels);
+
 VL_EXPORT
 void   vl_quickshift_delete (VlQS *q) ;
 /** @} */
@@ -64,6 +98,12 @@ void   vl_quickshift_delete (VlQS *q) ;
 VL_EXPORT
 void   vl_quickshift_process (VlQS *q) ;
 
+VL_EXPORT
+void   vl_quickshift_process_parents (VlQS *q) ;
+
+VL_EXPORT
+vl_bool vl_quickshift_has_simd (void) ;
+
 /** @} */
 
 /** @name Retrieve data and parameters
@@ -72,10 +112,23 @@ void   vl_quickshift_process (VlQS *q) ;
 VL_INLINE vl_qs_type    vl_quickshift_get_max_dist      (VlQS const *q) ;
 VL_INLINE vl_qs_type    vl_quickshift_get_kernel_size    (VlQS const *q) ;
 VL_INLINE vl_bool       vl_quickshift_get_medoid   (VlQS const *q) ;
+VL_INLINE vl_type       vl_quickshift_get_data_type (VlQS const *q) ;
+VL_INLINE int           vl_quickshift_get_num_threads (VlQS const *q) ;
+VL_INLINE vl_bool       vl_quickshift_get_exp_table (VlQS const *q) ;
+VL_INLINE vl_bool       vl_quickshift_get_approximate_density (VlQS const *q) ;
+VL_INLINE int           vl_quickshift_get_density_samples (VlQS const *q) ;
+VL_INLINE vl_uint32     vl_quickshift_get_density_seed (VlQS const *q) ;
+VL_INLINE int           vl_quickshift_get_tile_size (VlQS const *q) ;
+VL_INLINE VlArena *     vl_quickshift_get_arena (VlQS const *q) ;
+VL_INLINE int           vl_quickshift_get_pixel_stride (VlQS const *q) ;
+VL_INLINE int           vl_quickshift_get_channel_stride (VlQS const *q) ;
 
 VL_INLINE int *        vl_quickshift_get_parents  (VlQS const *q) ;
 VL_INLINE vl_qs_type * vl_quickshift_get_dists    (VlQS const *q) ;
 VL_INLINE vl_qs_type * vl_quickshift_get_density  (VlQS const *q) ;
+
+VL_INLINE vl_qs_type_f * vl_quickshift_get_dists_f   (VlQS const *q) ;
+VL_INLINE vl_qs_type_f * vl_quickshift_get_density_f (VlQS const *q) ;
 /** @} */
 
 /** @name Set parameters
@@ -84,6 +137,16 @@ VL_INLINE vl_qs_type * vl_quickshift_get_density  (VlQS const *q) ;
 VL_INLINE void vl_quickshift_set_max_dist    (VlQS *f, vl_qs_type tau) ;
 VL_INLINE void vl_quickshift_set_kernel_size  (VlQS *f, vl_qs_type sigma) ;
 VL_INLINE void vl_quickshift_set_medoid (VlQS *f, vl_bool medoid) ;
+VL_INLINE void vl_quickshift_set_num_threads (VlQS *f, int numThreads) ;
+VL_INLINE void vl_quickshift_set_exp_table (VlQS *f, vl_bool expTable) ;
+VL_INLINE void vl_quickshift_set_approximate_density (VlQS *f, vl_bool approximateDensity) ;
+VL_INLINE void vl_quickshift_set_density_samples (VlQS *f, int numSamples) ;
+VL_INLINE void vl_quickshift_set_density_seed (VlQS *f, vl_uint32 seed) ;
+VL_INLINE void vl_quickshift_set_tile_size (VlQS *f, int tileSize) ;
+VL_INLINE void vl_quickshift_set_arena (VlQS *f, VlArena *arena) ;
+VL_INLINE void vl_quickshift_set_layout (VlQS *f, int pixelStride, int channelStride) ;
+VL_INLINE void vl_quickshift_set_image (VlQS *f, vl_qs_type const * image) ;
+VL_INLINE void vl_quickshift_set_image_f (VlQS *f, vl_qs_type_f const * image) ;
 /** @} */
 
 /* -------------------------------------------------------------------
@@ -128,6 +191,128 @@ vl_quickshift_get_medoid (VlQS const *q)
   return q->medoid ;
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Get data type.
+ ** @param q quick shift object.
+ ** @return ::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT, the precision the object
+ **         computes in.
+ **/
+
+VL_INLINE vl_type
+vl_quickshift_get_data_type (VlQS const *q) 
+{
+  return q->dataType ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get number of threads.
+ ** @param q quick shift object.
+ ** @return the number of threads ::vl_quickshift_process uses.
+ **/
+
+VL_INLINE int
+vl_quickshift_get_num_threads (VlQS const *q) 
+{
+  return q->numThreads ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get exp table.
+ ** @param q quick shift object.
+ ** @return @c true if the density uses a table instead of @c exp.
+ **/
+
+VL_INLINE vl_bool
+vl_quickshift_get_exp_table (VlQS const *q) 
+{
+  return q->expTable ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get approximate density.
+ ** @param q quick shift object.
+ ** @return @c true if the density is approximated on a lattice.
+ **/
+
+VL_INLINE vl_bool
+vl_quickshift_get_approximate_density (VlQS const *q) 
+{
+  return q->approximateDensity ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get density samples.
+ ** @param q quick shift object.
+ ** @return the number of window offsets the density samples, or 0 if
+ **         it sums the whole window.
+ **/
+
+VL_INLINE int
+vl_quickshift_get_density_samples (VlQS const *q) 
+{
+  return q->densitySamples ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get density seed.
+ ** @param q quick shift object.
+ ** @return the seed of the sampled window offsets.
+ **/
+
+VL_INLINE vl_uint32
+vl_quickshift_get_density_seed (VlQS const *q) 
+{
+  return q->densitySeed ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get tile size.
+ ** @param q quick shift object.
+ ** @return the side of the tiles, or 0 if the image is processed whole.
+ **/
+
+VL_INLINE int
+vl_quickshift_get_tile_size (VlQS const *q) 
+{
+  return q->tileSize ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get arena.
+ ** @param q quick shift object.
+ ** @return the arena of the object (NULL if none).
+ **/
+
+VL_INLINE VlArena *
+vl_quickshift_get_arena (VlQS const *q) 
+{
+  return q->arena ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get pixel stride.
+ ** @param q quick shift object.
+ ** @return the distance between consecutive pixels in the image buffer.
+ **/
+
+VL_INLINE int
+vl_quickshift_get_pixel_stride (VlQS const *q) 
+{
+  return q->pixelStride ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get channel stride.
+ ** @param q quick shift object.
+ ** @return the distance between the channels of a pixel in the image buffer.
+ **/
+
+VL_INLINE int
+vl_quickshift_get_channel_stride (VlQS const *q) 
+{
+  return q->channelStride ;
+}
+
 /** ------------------------------------------------------------------
  ** @brief Get parents.
  ** @param q quick shift object.
@@ -144,7 +329,7 @@ vl_quickshift_get_parents (VlQS const *q)
 
 /** ------------------------------------------------------------------
  ** @brief Get dists.
- ** @param q quick shift object.
+ ** @param q quick shift object (double precision).
  ** @return for each pixel, the distance in feature space to the pixel
  **         that is its parent in the quick shift tree.
  **/
@@ -152,19 +337,44 @@ vl_quickshift_get_parents (VlQS const *q)
 VL_INLINE vl_qs_type *
 vl_quickshift_get_dists (VlQS const *q) 
 {
-  return q->dists ;
+  return (vl_qs_type *) q->dists ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get dists.
+ ** @param q quick shift object (single precision).
+ ** @return same as ::vl_quickshift_get_dists.
+ **/
+
+VL_INLINE vl_qs_type_f *
+vl_quickshift_get_dists_f (VlQS const *q) 
+{
+  return (vl_qs_type_f *) q->dists ;
 }
 
 /** ------------------------------------------------------------------
  ** @brief Get density.
- ** @param q quick shift object.
- ** @return the estimate of the density at each pixel.
+ ** @param q quick shift object (double precision).
+ ** @return the estimate of the density at each pixel (NULL after
+ **         processing in tiled mode, see ::vl_quickshift_set_tile_size).
  **/
 
 VL_INLINE vl_qs_type *
 vl_quickshift_get_density (VlQS const *q) 
 {
-  return q->density ;
+  return (vl_qs_type *) q->density ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get density.
+ ** @param q quick shift object (single precision).
+ ** @return same as ::vl_quickshift_get_density.
+ **/
+
+VL_INLINE vl_qs_type_f *
+vl_quickshift_get_density_f (VlQS const *q) 
+{
+  return (vl_qs_type_f *) q->density ;
 }
 
 /** ------------------------------------------------------------------
@@ -206,5 +416,187 @@ vl_quickshift_set_medoid (VlQS *q, vl_bool medoid)
   q -> medoid = medoid ;
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Set number of threads
+ ** @param q quick shift object.
+ ** @param numThreads number of threads ::vl_quickshift_process splits the
+ **        image columns between (default 1). The results do not depend on it.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_num_threads (VlQS *q, int numThreads) 
+{
+  q -> numThreads = numThreads ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set exp table
+ ** @param q quick shift object.
+ ** @param expTable @c true to evaluate the color factor of the density
+ **        kernel by interpolating a table of @c exp instead of calling
+ **        @c exp (default @c false).
+ **
+ ** The spatial factor always comes from an exact per-offset table. With
+ ** the table each color factor has a relative error below 3e-5 (and an
+ ** absolute error below 1e-13 for very dissimilar pixels), which may
+ ** change the parents of pixels whose densities are closer than that.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_exp_table (VlQS *q, vl_bool expTable) 
+{
+  q -> expTable = expTable ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set approximate density
+ ** @param q quick shift object.
+ ** @param approximateDensity @c true to compute the density on a
+ **        permutohedral lattice, in time independent of the kernel size
+ **        (default @c false).
+ **
+ ** The approximate density is only proportional to the exact one and
+ ** is not used for medoid shift (see @ref quickshift-approximate).
+ **/
+
+VL_INLINE void
+vl_quickshift_set_approximate_density (VlQS *q, vl_bool approximateDensity) 
+{
+  q -> approximateDensity = approximateDensity ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set density samples
+ ** @param q quick shift object.
+ ** @param numSamples number of window offsets the density samples, or
+ **        0 (default) to sum the whole window.
+ **
+ ** The offsets are drawn once per ::vl_quickshift_process, with the
+ ** seed ::vl_quickshift_set_density_seed, and shared by all the pixels,
+ ** so the density costs @a numSamples kernel evaluations per pixel
+ ** instead of @f$ (2R+1)^2 @f$ (see @ref quickshift-sampled). A number
+ ** at least that of the window offsets gives the exact density. The
+ ** approximate density (::vl_quickshift_set_approximate_density) does
+ ** not sample.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_density_samples (VlQS *q, int numSamples) 
+{
+  q -> densitySamples = numSamples ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set density seed
+ ** @param q quick shift object.
+ ** @param seed seed of the offsets sampled by the density (0 by default).
+ **
+ ** The same seed gives the same density, whatever the number of threads
+ ** and the instruction set.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_density_seed (VlQS *q, vl_uint32 seed) 
+{
+  q -> densitySeed = seed ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set tile size
+ ** @param q quick shift object.
+ ** @param tileSize side of the square tiles ::vl_quickshift_process
+ **        splits the image into, or 0 (default) to process it whole.
+ **
+ ** In tiled mode the working memory is bounded per tile and the object
+ ** does not keep the density of the image (::vl_quickshift_get_density
+ ** returns NULL). The parents and distances are the same as without
+ ** tiles (see @ref quickshift-tiles).
+ **/
+
+VL_INLINE void
+vl_quickshift_set_tile_size (VlQS *q, int tileSize) 
+{
+  q -> tileSize = tileSize ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set arena
+ ** @param q quick shift object.
+ ** @param arena arena (NULL, the default, for none). The object does
+ **        not own it.
+ **
+ ** ::vl_quickshift_process resets the arena and allocates the lattice
+ ** of the approximate density from it, so images of the same size
+ ** reuse the same memory without calling ::vl_malloc. In tiled mode
+ ** the tiles use ::vl_malloc instead, since they run on several
+ ** threads.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_arena (VlQS *q, VlArena *arena) 
+{
+  q -> arena = arena ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set the memory layout of the image
+ ** @param q quick shift object.
+ ** @param pixelStride distance between consecutive pixels.
+ ** @param channelStride distance between the channels of a pixel.
+ **
+ ** The default (@c pixelStride = 1, @c channelStride = @c height *
+ ** @c width) is the planar, column major layout of MATLAB. An
+ ** interleaved image, with the channels of each pixel stored together
+ ** and possibly padded to @c stride values, uses
+ ** <code>vl_quickshift_set_layout(q, stride, 1)</code>. Each distance
+ ** then reads two contiguous runs of values instead of @c channels
+ ** values far apart.
+ **
+ ** The SIMD kernels only process the planar layout (see
+ ** ::vl_quickshift_has_simd); an interleaved image uses the scalar code.
+ **
+ ** The first image dimension (@c height) is the one that varies fastest
+ ** in memory. A row major image (e.g. an ITK image buffer) is therefore
+ ** processed by passing its width as @c height and its height as
+ ** @c width; the parents are then linear indices into the row major
+ ** buffer.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_layout (VlQS *q, int pixelStride, int channelStride) 
+{
+  q -> pixelStride = pixelStride ;
+  q -> channelStride = channelStride ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set the image
+ ** @param q quick shift object (double precision).
+ ** @param image new image, of the size and layout of the previous one.
+ **
+ ** Lets the object process another image of the same size without
+ ** reallocating its results and working memory. The results of the
+ ** previous image are overwritten by the next ::vl_quickshift_process.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_image (VlQS *q, vl_qs_type const * image) 
+{
+  q -> image = (void *) image ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set the image
+ ** @param q quick shift object (single precision).
+ ** @param image new image.
+ **
+ ** Same as ::vl_quickshift_set_image.
+ **/
+
+VL_INLINE void
+vl_quickshift_set_image_f (VlQS *q, vl_qs_type_f const * image) 
+{
+  q -> image = (void *) image ;
+}
 
 #endif
\ No newline at end of file
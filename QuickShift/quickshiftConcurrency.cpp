@@ -0,0 +1,125 @@
+// Run several quick shift filters at once, one thread each, and report how the throughput scales with their number.
+// Usage: quickshiftConcurrency KernelSize MaxDist Ratio Iterations MaxInstances image [UseApproximateDensity]
+// Each instance segments its own copy of the image Iterations times. With no shared state between the engines the
+// time per round stays flat, i.e. the speedup over one instance grows linearly up to the number of cores.
+
+#include "itkImage.h"
+#include "itkImageDuplicator.h"
+#include "itkImageFileReader.h"
+#include "itkMultiThreader.h"
+#include "itkTimeProbe.h"
+#include "itkVectorImage.h"
+
+#include "itkQuickShiftSegmentation.h"
+
+// STL
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef itk::VectorImage<float, 2> ImageType;
+typedef itk::Image<unsigned int, 2> LabelImageType;
+typedef itk::QuickShiftSegmentation<ImageType, LabelImageType> QuickShiftSegmentationType;
+
+struct Instances
+{
+  std::vector<QuickShiftSegmentationType::Pointer> Filters;
+  int Iterations;
+};
+
+static ITK_THREAD_RETURN_TYPE RunInstance(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  Instances* instances = static_cast<Instances*>(threadInfo->UserData);
+  QuickShiftSegmentationType* filter = instances->Filters[threadInfo->ThreadID];
+  for(int iteration = 0; iteration < instances->Iterations; ++iteration)
+    {
+    filter->Modified();
+    filter->Update();
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 7)
+    {
+    std::cerr << "Required: KernelSize MaxDist Ratio Iterations MaxInstances image [UseApproximateDensity]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::stringstream ss;
+  ss << argv[1] << " " << argv[2] << " " << argv[3] << " " << argv[4] << " " << argv[5];
+  float kernelSize;
+  float maxDist;
+  float ratio;
+  int iterations;
+  int maxInstances;
+  ss >> kernelSize >> maxDist >> ratio >> iterations >> maxInstances;
+  const bool useApproximateDensity = (argc > 7 && std::atoi(argv[7]) != 0);
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(argv[6]);
+  reader->Update();
+
+  std::vector<std::string> rows;
+  double singleInstanceTime = 0;
+  for(int numberOfInstances = 1; numberOfInstances <= maxInstances; ++numberOfInstances)
+    {
+    // Each instance gets its own input and filter (with a single engine thread), all set up before the clock starts,
+    // and one warm-up update so that the timed ones reuse their buffers.
+    Instances instances;
+    instances.Iterations = iterations;
+    for(int instance = 0; instance < numberOfInstances; ++instance)
+      {
+      typedef itk::ImageDuplicator<ImageType> DuplicatorType;
+      DuplicatorType::Pointer duplicator = DuplicatorType::New();
+      duplicator->SetInputImage(reader->GetOutput());
+      duplicator->Update();
+
+      QuickShiftSegmentationType::Pointer filter = QuickShiftSegmentationType::New();
+      filter->SetKernelSize(kernelSize);
+      filter->SetMaxDist(maxDist);
+      filter->SetRatio(ratio);
+      filter->SetUseApproximateDensity(useApproximateDensity);
+      filter->SetNumberOfThreads(1);
+      filter->SetInput(duplicator->GetOutput());
+      filter->Update();
+      instances.Filters.push_back(filter);
+      }
+
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    threader->SetNumberOfThreads(numberOfInstances);
+    threader->SetSingleMethod(RunInstance, &instances);
+
+    itk::TimeProbe clock;
+    clock.Start();
+    threader->SingleMethodExecute();
+    clock.Stop();
+
+    const double time = clock.GetTotal();
+    if(numberOfInstances == 1)
+      {
+      singleInstanceTime = time;
+      }
+    // Every instance does the work of the single one, so the speedup is the instances times the time ratio.
+    const double speedup = numberOfInstances * singleInstanceTime / time;
+
+    std::stringstream row;
+    row << numberOfInstances << ", " << time << ", " << numberOfInstances * iterations / time << ", "
+        << speedup << ", " << speedup / numberOfInstances;
+    rows.push_back(row.str());
+    }
+
+  // The filters log as they run, so the table comes last.
+  std::cout << "instances, time, images per second, speedup, efficiency" << std::endl;
+  for(unsigned int row = 0; row < rows.size(); ++row)
+    {
+    std::cout << rows[row] << std::endl;
+    }
+
+  return EXIT_SUCCESS;
+}
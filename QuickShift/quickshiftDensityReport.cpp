@@ -0,0 +1,139 @@
+// Compare the approximate (lattice) quick shift density against the exact one on a set of images.
+// Usage: quickshiftDensityReport KernelSize MaxDist Ratio image1 [image2 ...]
+// The approximate density is only proportional to the exact one, so it is first scaled by the least squares factor.
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkTimeProbe.h"
+#include "itkVectorImage.h"
+
+#include "quickshift.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+typedef itk::VectorImage<float, 2> ImageType;
+
+static int CountRoots(const int* parents, const int totalPixels)
+{
+  int roots = 0;
+  for(int i = 0; i < totalPixels; ++i)
+    {
+    if(parents[i] == i)
+      {
+      roots++;
+      }
+    }
+  return roots;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 5)
+    {
+    std::cerr << "Required: KernelSize MaxDist Ratio image1 [image2 ...]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::stringstream ss;
+  ss << argv[1] << " " << argv[2] << " " << argv[3];
+  double kernelSize;
+  double maxDist;
+  double ratio;
+  ss >> kernelSize >> maxDist >> ratio;
+
+  std::cout << "image, scale, mean relative error, max relative error, differing parents (fraction), "
+            << "exact segments, approximate segments, exact time, approximate time" << std::endl;
+
+  for(int imageId = 4; imageId < argc; ++imageId)
+    {
+    typedef itk::ImageFileReader<ImageType> ReaderType;
+    ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(argv[imageId]);
+    reader->Update();
+
+    const int width = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[0];
+    const int height = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[1];
+    const int channels = reader->GetOutput()->GetNumberOfComponentsPerPixel();
+    const int totalPixels = width*height;
+
+    // Interleaved, row major, as the filter passes it to the engine.
+    std::vector<vl_qs_type> image(totalPixels*channels);
+    itk::ImageRegionConstIterator<ImageType> imageIterator(reader->GetOutput(), reader->GetOutput()->GetLargestPossibleRegion());
+    vl_qs_type* pixel = &image[0];
+    while(!imageIterator.IsAtEnd())
+      {
+      for(int component = 0; component < channels; ++component)
+        {
+        pixel[component] = imageIterator.Get()[component] * ratio;
+        }
+      pixel += channels;
+      ++imageIterator;
+      }
+
+    itk::TimeProbe exactClock;
+    exactClock.Start();
+    VlQS* quickshift = vl_quickshift_new(&image[0], width, height, channels);
+    vl_quickshift_set_layout(quickshift, channels, 1);
+    vl_quickshift_set_kernel_size(quickshift, kernelSize);
+    vl_quickshift_set_max_dist(quickshift, maxDist);
+    vl_quickshift_process(quickshift);
+    exactClock.Stop();
+
+    itk::TimeProbe approximateClock;
+    approximateClock.Start();
+    VlQS* approximateQuickshift = vl_quickshift_new(&image[0], width, height, channels);
+    vl_quickshift_set_layout(approximateQuickshift, channels, 1);
+    vl_quickshift_set_kernel_size(approximateQuickshift, kernelSize);
+    vl_quickshift_set_max_dist(approximateQuickshift, maxDist);
+    vl_quickshift_set_approximate_density(approximateQuickshift, true);
+    vl_quickshift_process(approximateQuickshift);
+    approximateClock.Stop();
+
+    const vl_qs_type* density = vl_quickshift_get_density(quickshift);
+    const vl_qs_type* approximateDensity = vl_quickshift_get_density(approximateQuickshift);
+    const int* parents = vl_quickshift_get_parents(quickshift);
+    const int* approximateParents = vl_quickshift_get_parents(approximateQuickshift);
+
+    // Least squares scale between the two densities
+    double crossProduct = 0;
+    double approximateNorm = 0;
+    for(int i = 0; i < totalPixels; ++i)
+      {
+      crossProduct += density[i] * approximateDensity[i];
+      approximateNorm += approximateDensity[i] * approximateDensity[i];
+      }
+    const double scale = crossProduct / approximateNorm;
+
+    double meanRelativeError = 0;
+    double maxRelativeError = 0;
+    int differingParents = 0;
+    for(int i = 0; i < totalPixels; ++i)
+      {
+      const double relativeError = std::abs(scale * approximateDensity[i] - density[i]) / density[i];
+      meanRelativeError += relativeError;
+      maxRelativeError = std::max(maxRelativeError, relativeError);
+      if(parents[i] != approximateParents[i])
+        {
+        differingParents++;
+        }
+      }
+    meanRelativeError /= totalPixels;
+
+    std::cout << argv[imageId] << ", " << scale << ", " << meanRelativeError << ", " << maxRelativeError << ", "
+              << static_cast<double>(differingParents)/static_cast<double>(totalPixels) << ", "
+              << CountRoots(parents, totalPixels) << ", " << CountRoots(approximateParents, totalPixels) << ", "
+              << exactClock.GetTotal() << ", " << approximateClock.GetTotal() << std::endl;
+
+    vl_quickshift_delete(quickshift);
+    vl_quickshift_delete(approximateQuickshift);
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+// Compare the single precision quick shift engine against the double precision one on a set of images.
+// Usage: quickshiftPrecision Tolerance KernelSize MaxDist Ratio image1 [image2 ...]
+// Reports the fraction of pixels whose parent differs and fails if it exceeds Tolerance for any image.
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkVectorImage.h"
+
+#include "quickshift.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+typedef itk::VectorImage<float, 2> ImageType;
+
+int main(int argc, char* argv[])
+{
+  if(argc < 6)
+    {
+    std::cerr << "Required: Tolerance KernelSize MaxDist Ratio image1 [image2 ...]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::stringstream ss;
+  ss << argv[1] << " " << argv[2] << " " << argv[3] << " " << argv[4];
+  double tolerance;
+  double kernelSize;
+  double maxDist;
+  double ratio;
+  ss >> tolerance >> kernelSize >> maxDist >> ratio;
+
+  std::cout << "image, differing parents, differing parents (fraction), largest dists difference" << std::endl;
+
+  bool withinTolerance = true;
+  for(int imageId = 5; imageId < argc; ++imageId)
+    {
+    typedef itk::ImageFileReader<ImageType> ReaderType;
+    ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(argv[imageId]);
+    reader->Update();
+
+    const int width = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[0];
+    const int height = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[1];
+    const int channels = reader->GetOutput()->GetNumberOfComponentsPerPixel();
+    const int totalPixels = width*height;
+
+    // Column major, channel planar, as the engine expects.
+    std::vector<vl_qs_type> image(totalPixels*channels);
+    std::vector<vl_qs_type_f> singlePrecisionImage(totalPixels*channels);
+    itk::ImageRegionConstIterator<ImageType> imageIterator(reader->GetOutput(), reader->GetOutput()->GetLargestPossibleRegion());
+    while(!imageIterator.IsAtEnd())
+      {
+      for(int component = 0; component < channels; ++component)
+        {
+        const int linearIndex = component*totalPixels + imageIterator.GetIndex()[1] + height*imageIterator.GetIndex()[0];
+        image[linearIndex] = imageIterator.Get()[component] * ratio;
+        singlePrecisionImage[linearIndex] = static_cast<vl_qs_type_f>(image[linearIndex]);
+        }
+      ++imageIterator;
+      }
+
+    VlQS* quickshift = vl_quickshift_new(&image[0], height, width, channels);
+    vl_quickshift_set_kernel_size(quickshift, kernelSize);
+    vl_quickshift_set_max_dist(quickshift, maxDist);
+    vl_quickshift_process(quickshift);
+
+    VlQS* singlePrecisionQuickshift = vl_quickshift_new_f(&singlePrecisionImage[0], height, width, channels);
+    vl_quickshift_set_kernel_size(singlePrecisionQuickshift, kernelSize);
+    vl_quickshift_set_max_dist(singlePrecisionQuickshift, maxDist);
+    vl_quickshift_process(singlePrecisionQuickshift);
+
+    const int* parents = vl_quickshift_get_parents(quickshift);
+    const int* singlePrecisionParents = vl_quickshift_get_parents(singlePrecisionQuickshift);
+    const vl_qs_type* dists = vl_quickshift_get_dists(quickshift);
+    const vl_qs_type_f* singlePrecisionDists = vl_quickshift_get_dists_f(singlePrecisionQuickshift);
+
+    int differingParents = 0;
+    double largestDistsDifference = 0;
+    for(int i = 0; i < totalPixels; ++i)
+      {
+      if(parents[i] != singlePrecisionParents[i])
+        {
+        differingParents++;
+        }
+      else if(parents[i] != i) // roots have infinite dists
+        {
+        largestDistsDifference = std::max(largestDistsDifference, std::abs(dists[i] - singlePrecisionDists[i]));
+        }
+      }
+    const double fraction = static_cast<double>(differingParents)/static_cast<double>(totalPixels);
+
+    std::cout << argv[imageId] << ", " << differingParents << ", " << fraction << ", " << largestDistsDifference << std::endl;
+
+    if(fraction > tolerance)
+      {
+      withinTolerance = false;
+      }
+
+    vl_quickshift_delete(quickshift);
+    vl_quickshift_delete(singlePrecisionQuickshift);
+    }
+
+  if(!withinTolerance)
+    {
+    std::cerr << "The single precision parents differ on more than " << tolerance << " of the pixels." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/** @internal
+ ** @file     quickshift_avx2.c
+ ** @brief    Quick shift SIMD row kernels - AVX2
+ **
+ ** Compiled with AVX2 enabled; only called when the CPU supports it
+ ** (see quickshift_kernels.h).
+ **/
+
+#ifndef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+#include "quickshift_kernels.h"
+#include "mathop.h"
+
+#include <math.h>
+
+#ifndef VL_DISABLE_AVX2
+#include <immintrin.h>
+
+#define FLT VL_TYPE_FLOAT
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_avx2.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_avx2.c"
+#endif
+
+/* ! VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#else
+
+#if (FLT == VL_TYPE_FLOAT)
+#  define T float
+#  define SFX avx2_f
+#  define T_INF VL_INFINITY_F
+#  define T_EXP expf
+#  define T_SQRT sqrtf
+#  define T_TABLE_EXP _vl_quickshift_table_exp_f
+#  define VTYPE __m256
+#  define VSIZE 8
+#  define VMASK __m256
+#  define VLOADU _mm256_loadu_ps
+#  define VSTOREU _mm256_storeu_ps
+#  define VSET1 _mm256_set1_ps
+#  define VADD _mm256_add_ps
+#  define VSUB _mm256_sub_ps
+#  define VMUL _mm256_mul_ps
+#  define VCMPGT(a,b) _mm256_cmp_ps(a,b,_CMP_GT_OQ)
+#  define VCMPLE(a,b) _mm256_cmp_ps(a,b,_CMP_LE_OQ)
+#  define VCMPLT(a,b) _mm256_cmp_ps(a,b,_CMP_LT_OQ)
+#  define VAND _mm256_and_ps
+#  define VOR _mm256_or_ps
+#  define VBLEND(a,b,m) _mm256_blendv_ps(a,b,m)
+#  define VANY _mm256_movemask_ps
+#else
+#  define T double
+#  define SFX avx2_d
+#  define T_INF VL_INFINITY_D
+#  define T_EXP exp
+#  define T_SQRT sqrt
+#  define T_TABLE_EXP _vl_quickshift_table_exp_d
+#  define VTYPE __m256d
+#  define VSIZE 4
+#  define VMASK __m256d
+#  define VLOADU _mm256_loadu_pd
+#  define VSTOREU _mm256_storeu_pd
+#  define VSET1 _mm256_set1_pd
+#  define VADD _mm256_add_pd
+#  define VSUB _mm256_sub_pd
+#  define VMUL _mm256_mul_pd
+#  define VCMPGT(a,b) _mm256_cmp_pd(a,b,_CMP_GT_OQ)
+#  define VCMPLE(a,b) _mm256_cmp_pd(a,b,_CMP_LE_OQ)
+#  define VCMPLT(a,b) _mm256_cmp_pd(a,b,_CMP_LT_OQ)
+#  define VAND _mm256_and_pd
+#  define VOR _mm256_or_pd
+#  define VBLEND(a,b,m) _mm256_blendv_pd(a,b,m)
+#  define VANY _mm256_movemask_pd
+#endif
+
+#include "quickshift_simd.h"
+
+#undef T
+#undef SFX
+#undef T_INF
+#undef T_EXP
+#undef T_SQRT
+#undef T_TABLE_EXP
+#undef VTYPE
+#undef VSIZE
+#undef VMASK
+#undef VLOADU
+#undef VSTOREU
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VCMPGT
+#undef VCMPLE
+#undef VCMPLT
+#undef VAND
+#undef VOR
+#undef VBLEND
+#undef VANY
+#undef FLT
+#undef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+/* VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#endif
@@ -0,0 +1,107 @@
+/** @internal
+ ** @file     quickshift_avx512.c
+ ** @brief    Quick shift SIMD row kernels - AVX-512
+ **
+ ** Compiled with AVX-512 enabled; only called when the CPU supports it
+ ** (see quickshift_kernels.h).
+ **/
+
+#ifndef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+#include "quickshift_kernels.h"
+#include "mathop.h"
+
+#include <math.h>
+
+#ifndef VL_DISABLE_AVX512
+#include <immintrin.h>
+
+#define FLT VL_TYPE_FLOAT
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_avx512.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_avx512.c"
+#endif
+
+/* ! VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#else
+
+#if (FLT == VL_TYPE_FLOAT)
+#  define T float
+#  define SFX avx512_f
+#  define T_INF VL_INFINITY_F
+#  define T_EXP expf
+#  define T_SQRT sqrtf
+#  define T_TABLE_EXP _vl_quickshift_table_exp_f
+#  define VTYPE __m512
+#  define VSIZE 16
+#  define VMASK __mmask16
+#  define VLOADU _mm512_loadu_ps
+#  define VSTOREU _mm512_storeu_ps
+#  define VSET1 _mm512_set1_ps
+#  define VADD _mm512_add_ps
+#  define VSUB _mm512_sub_ps
+#  define VMUL _mm512_mul_ps
+#  define VCMPGT(a,b) _mm512_cmp_ps_mask(a,b,_CMP_GT_OQ)
+#  define VCMPLE(a,b) _mm512_cmp_ps_mask(a,b,_CMP_LE_OQ)
+#  define VCMPLT(a,b) _mm512_cmp_ps_mask(a,b,_CMP_LT_OQ)
+#  define VAND(a,b) ((VMASK) ((a) & (b)))
+#  define VOR(a,b) ((VMASK) ((a) | (b)))
+#  define VBLEND(a,b,m) _mm512_mask_blend_ps(m,a,b)
+#  define VANY(m) (m)
+#else
+#  define T double
+#  define SFX avx512_d
+#  define T_INF VL_INFINITY_D
+#  define T_EXP exp
+#  define T_SQRT sqrt
+#  define T_TABLE_EXP _vl_quickshift_table_exp_d
+#  define VTYPE __m512d
+#  define VSIZE 8
+#  define VMASK __mmask8
+#  define VLOADU _mm512_loadu_pd
+#  define VSTOREU _mm512_storeu_pd
+#  define VSET1 _mm512_set1_pd
+#  define VADD _mm512_add_pd
+#  define VSUB _mm512_sub_pd
+#  define VMUL _mm512_mul_pd
+#  define VCMPGT(a,b) _mm512_cmp_pd_mask(a,b,_CMP_GT_OQ)
+#  define VCMPLE(a,b) _mm512_cmp_pd_mask(a,b,_CMP_LE_OQ)
+#  define VCMPLT(a,b) _mm512_cmp_pd_mask(a,b,_CMP_LT_OQ)
+#  define VAND(a,b) ((VMASK) ((a) & (b)))
+#  define VOR(a,b) ((VMASK) ((a) | (b)))
+#  define VBLEND(a,b,m) _mm512_mask_blend_pd(m,a,b)
+#  define VANY(m) (m)
+#endif
+
+#include "quickshift_simd.h"
+
+#undef T
+#undef SFX
+#undef T_INF
+#undef T_EXP
+#undef T_SQRT
+#undef T_TABLE_EXP
+#undef VTYPE
+#undef VSIZE
+#undef VMASK
+#undef VLOADU
+#undef VSTOREU
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VCMPGT
+#undef VCMPLE
+#undef VCMPLT
+#undef VAND
+#undef VOR
+#undef VBLEND
+#undef VANY
+#undef FLT
+#undef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+/* VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#endif
@@ -0,0 +1,183 @@
+/** @internal
+ ** @file     quickshift_kernels.h
+ ** @brief    Quick shift SIMD row kernels
+ **
+ ** The kernels process runs of consecutive pixels of an image column
+ ** (consecutive values of the first index @c i1), one pixel per vector
+ ** lane, reading a planar copy of the image: channel @c k of pixel
+ ** <code>i1 + N1 * i2</code> is <code>P[S * k + i1 + N1 * i2]</code>.
+ ** Each lane performs the same operations in the same order as the
+ ** scalar code in quickshift.c, so the results do not depend on the
+ ** instruction set. The windows of all the pixels of a run must lie
+ ** inside the image along the first dimension.
+ **
+ ** The kernels are compiled once per instruction set (quickshift_sse2.c,
+ ** quickshift_avx2.c, quickshift_avx512.c) from the body in
+ ** quickshift_simd.h.
+ **/
+
+#ifndef VL_QUICKSHIFT_KERNELS_H
+#define VL_QUICKSHIFT_KERNELS_H
+
+#include "generic.h"
+
+/** @internal @brief Samples of the exp table per unit of its argument */
+#define VL_QS_EXP_TABLE_STEPS 64
+/** @internal @brief Largest argument of the exp table */
+#define VL_QS_EXP_TABLE_MAX 30
+/** @internal @brief Number of samples of the exp table (one extra for interpolation) */
+#define VL_QS_EXP_TABLE_SIZE (VL_QS_EXP_TABLE_MAX * VL_QS_EXP_TABLE_STEPS + 2)
+
+/** -----------------------------------------------------------------
+ ** @internal
+ ** @brief Evaluates exp(-x) for x >= 0 from a table
+ ** @param table ::VL_QS_EXP_TABLE_SIZE samples of exp(-x), spaced
+ **        1 / ::VL_QS_EXP_TABLE_STEPS apart.
+ ** @param x argument.
+ **
+ ** Linear interpolation between the samples. The relative error is at
+ ** most h^2/8 (h the sample spacing, i.e. about 3e-5); beyond the last
+ ** sample the result is 0, an absolute error below exp(-::VL_QS_EXP_TABLE_MAX).
+ **/
+
+VL_INLINE float
+_vl_quickshift_table_exp_f (float const * table, float x)
+{
+  float t = x * VL_QS_EXP_TABLE_STEPS ;
+  int i ;
+  if (t >= VL_QS_EXP_TABLE_MAX * VL_QS_EXP_TABLE_STEPS) {
+    return 0 ;
+  }
+  i = (int) t ;
+  return table [i] + (t - i) * (table [i + 1] - table [i]) ;
+}
+
+/** @internal @brief Same as ::_vl_quickshift_table_exp_f, double precision */
+
+VL_INLINE double
+_vl_quickshift_table_exp_d (double const * table, double x)
+{
+  double t = x * VL_QS_EXP_TABLE_STEPS ;
+  int i ;
+  if (t >= VL_QS_EXP_TABLE_MAX * VL_QS_EXP_TABLE_STEPS) {
+    return 0 ;
+  }
+  i = (int) t ;
+  return table [i] + (t - i) * (table [i + 1] - table [i]) ;
+}
+
+/** @internal @brief Density of a run of pixels (single precision)
+ **
+ ** Sets <code>E[i1 + N1 * i2]</code> for @c i1 in [@a i1begin,
+ ** @a i1end), a multiple of the number of lanes. @a expTable is NULL
+ ** to call @c exp. Offsets of spatial weight 0 are skipped.
+ **/
+typedef void (*_VlQSDensityRow_f) (float const * P, vl_size S, int N1, int N2, int K, int R,
+                                   float const * spatialWeights, float const * expTable, float scale,
+                                   int i1begin, int i1end, int i2, float * E) ;
+
+/** @internal @brief Parents of a run of pixels (single precision)
+ **
+ ** Sets @c parents and @c dists of the pixels @c i1 in [@a i1begin,
+ ** @a i1end), a multiple of the number of lanes. The candidates are
+ ** the @a numOffsets window offsets (d1, d2) in @a offsets, sorted by
+ ** spatial distance.
+ **/
+typedef void (*_VlQSParentsRow_f) (float const * P, vl_size S, int N1, int N2, int K, int tR,
+                                   float tau2, int const * offsets, int numOffsets, float const * E,
+                                   int i1begin, int i1end, int i2, int * parents, float * dists) ;
+
+/** @internal @brief Medoid shift density and votes of a run of pixels (single precision)
+ **
+ ** Sets <code>E[i1 + N1 * i2]</code> as ::_VlQSDensityRow_f and adds the
+ ** votes of the window to the planes of @a M (<code>N1 * N2</code>
+ ** apart), which must be zero on entry: <code>(j1, j2, I_j) * F_ij</code>
+ ** with <code>F_ij</code> the (negated) kernel.
+ **/
+typedef void (*_VlQSMedoidDensityRow_f) (float const * P, vl_size S, int N1, int N2, int K, int R,
+                                         float const * spatialWeights, float const * expTable, float scale,
+                                         int i1begin, int i1end, int i2, float * E, float * M) ;
+
+/** @internal @brief Medoid shift parents of a run of pixels (single precision)
+ **
+ ** Sets @c parents to the pixel of the @a R window with the largest
+ ** score <code>Q_ij = - n_j E_i - 2 (j1, j2, I_j) . M_i</code>, if
+ ** positive, and @c dists to that score.
+ **/
+typedef void (*_VlQSMedoidParentsRow_f) (float const * P, vl_size S, int N1, int N2, int K, int R,
+                                         float const * E, float const * M, float const * n,
+                                         int i1begin, int i1end, int i2, int * parents, float * dists) ;
+
+/** @internal @brief Same as ::_VlQSDensityRow_f, double precision */
+typedef void (*_VlQSDensityRow_d) (double const * P, vl_size S, int N1, int N2, int K, int R,
+                                   double const * spatialWeights, double const * expTable, double scale,
+                                   int i1begin, int i1end, int i2, double * E) ;
+
+/** @internal @brief Same as ::_VlQSParentsRow_f, double precision */
+typedef void (*_VlQSParentsRow_d) (double const * P, vl_size S, int N1, int N2, int K, int tR,
+                                   double tau2, int const * offsets, int numOffsets, double const * E,
+                                   int i1begin, int i1end, int i2, int * parents, double * dists) ;
+
+/** @internal @brief Same as ::_VlQSMedoidDensityRow_f, double precision */
+typedef void (*_VlQSMedoidDensityRow_d) (double const * P, vl_size S, int N1, int N2, int K, int R,
+                                         double const * spatialWeights, double const * expTable, double scale,
+                                         int i1begin, int i1end, int i2, double * E, double * M) ;
+
+/** @internal @brief Same as ::_VlQSMedoidParentsRow_f, double precision */
+typedef void (*_VlQSMedoidParentsRow_d) (double const * P, vl_size S, int N1, int N2, int K, int R,
+                                         double const * E, double const * M, double const * n,
+                                         int i1begin, int i1end, int i2, int * parents, double * dists) ;
+
+#define VL_QS_DECLARE_KERNELS(isa)                                      \
+  void _vl_quickshift_density_row_ ## isa ## _f                        \
+    (float const * P, vl_size S, int N1, int N2, int K, int R,         \
+     float const * spatialWeights, float const * expTable, float scale,\
+     int i1begin, int i1end, int i2, float * E) ;                      \
+  void _vl_quickshift_parents_row_ ## isa ## _f                        \
+    (float const * P, vl_size S, int N1, int N2, int K, int tR,        \
+     float tau2, int const * offsets, int numOffsets, float const * E, \
+     int i1begin, int i1end, int i2, int * parents, float * dists) ;   \
+  void _vl_quickshift_medoid_density_row_ ## isa ## _f                 \
+    (float const * P, vl_size S, int N1, int N2, int K, int R,         \
+     float const * spatialWeights, float const * expTable, float scale,\
+     int i1begin, int i1end, int i2, float * E, float * M) ;           \
+  void _vl_quickshift_medoid_parents_row_ ## isa ## _f                 \
+    (float const * P, vl_size S, int N1, int N2, int K, int R,         \
+     float const * E, float const * M, float const * n,                \
+     int i1begin, int i1end, int i2, int * parents, float * dists) ;   \
+  void _vl_quickshift_density_row_ ## isa ## _d                        \
+    (double const * P, vl_size S, int N1, int N2, int K, int R,        \
+     double const * spatialWeights, double const * expTable, double scale,\
+     int i1begin, int i1end, int i2, double * E) ;                     \
+  void _vl_quickshift_parents_row_ ## isa ## _d                        \
+    (double const * P, vl_size S, int N1, int N2, int K, int tR,       \
+     double tau2, int const * offsets, int numOffsets, double const * E,\
+     int i1begin, int i1end, int i2, int * parents, double * dists) ;  \
+  void _vl_quickshift_medoid_density_row_ ## isa ## _d                 \
+    (double const * P, vl_size S, int N1, int N2, int K, int R,        \
+     double const * spatialWeights, double const * expTable, double scale,\
+     int i1begin, int i1end, int i2, double * E, double * M) ;         \
+  void _vl_quickshift_medoid_parents_row_ ## isa ## _d                 \
+    (double const * P, vl_size S, int N1, int N2, int K, int R,        \
+     double const * E, double const * M, double const * n,             \
+     int i1begin, int i1end, int i2, int * parents, double * dists) ;
+
+#if defined(VL_ARCH_IX86) || defined(VL_ARCH_X64)
+#ifndef VL_DISABLE_SSE2
+VL_QS_DECLARE_KERNELS(sse2)
+#endif
+#ifndef VL_DISABLE_AVX2
+VL_QS_DECLARE_KERNELS(avx2)
+#endif
+#ifndef VL_DISABLE_AVX512
+VL_QS_DECLARE_KERNELS(avx512)
+#endif
+#else
+#define VL_DISABLE_SSE2
+#define VL_DISABLE_AVX2
+#define VL_DISABLE_AVX512
+#endif
+
+#undef VL_QS_DECLARE_KERNELS
+
+#endif
@@ -0,0 +1,243 @@
+/** @internal
+ ** @file     quickshift_simd.h
+ ** @brief    Quick shift SIMD row kernels - Body
+ **
+ ** Included by quickshift_sse2.c, quickshift_avx2.c and
+ ** quickshift_avx512.c once per precision, with these macros defined:
+ **
+ ** - @c T, @c SFX: element type and function suffix (e.g. @c avx2_f);
+ ** - @c T_INF, @c T_EXP, @c T_SQRT, @c T_TABLE_EXP: scalar functions,
+ **   the same as in quickshift.c;
+ ** - @c VTYPE, @c VSIZE: vector type and number of lanes;
+ ** - @c VMASK: lane mask type;
+ ** - @c VLOADU, @c VSTOREU, @c VSET1, @c VADD, @c VSUB, @c VMUL;
+ ** - @c VCMPGT, @c VCMPLE, @c VCMPLT, @c VAND, @c VOR: lane masks;
+ ** - @c VBLEND(a,b,m): @c b in the lanes of @c m, @c a elsewhere;
+ ** - @c VANY(m): non zero if any lane of @c m is set.
+ **
+ ** See quickshift_kernels.h.
+ **/
+
+/** @internal @brief Density of a run of pixels (see ::_VlQSDensityRow_f) */
+
+void
+VL_XCAT(_vl_quickshift_density_row_, SFX)
+(T const * P, vl_size S, int N1, int N2, int K, int R,
+ T const * spatialWeights, T const * expTable, T scale,
+ int i1begin, int i1end, int i2, T * E)
+{
+  T x [VSIZE] ;
+  T w [VSIZE] ;
+  int j2min = VL_MAX(i2 - R, 0   ) ;
+  int j2max = VL_MIN(i2 + R, N2-1) ;
+  int i1, j2, d1, k, l ;
+
+  for (i1 = i1begin ; i1 < i1end ; i1 += VSIZE) {
+    VTYPE density = VSET1(0) ;
+    for (j2 = j2min ; j2 <= j2max ; ++ j2) {
+      T const * spatialRow = spatialWeights + (2*R+1) * (j2 - i2 + R) + R ;
+      for (d1 = -R ; d1 <= R ; ++ d1) {
+        VTYPE dist = VSET1(0) ;
+        if (spatialRow [d1] == 0) continue ;
+        for (k = 0 ; k < K ; ++k) {
+          T const * plane = P + S * k ;
+          VTYPE d = VSUB(VLOADU(plane + i1 + N1 * i2),
+                         VLOADU(plane + i1 + d1 + N1 * j2)) ;
+          dist = VADD(dist, VMUL(d, d)) ;
+        }
+        /* exp (or its table) lane by lane, as the scalar code does */
+        VSTOREU(x, VMUL(dist, VSET1(scale))) ;
+        for (l = 0 ; l < VSIZE ; ++l) {
+          w [l] = expTable ? T_TABLE_EXP(expTable, x [l]) : T_EXP(- x [l]) ;
+        }
+        density = VADD(density, VMUL(VSET1(spatialRow [d1]), VLOADU(w))) ;
+      }
+    }
+    VSTOREU(E + i1 + N1 * i2, density) ;
+  }
+}
+
+/** @internal @brief Parents of a run of pixels (see ::_VlQSParentsRow_f) */
+
+void
+VL_XCAT(_vl_quickshift_parents_row_, SFX)
+(T const * P, vl_size S, int N1, int N2, int K, int tR,
+ T tau2, int const * offsets, int numOffsets, T const * E,
+ int i1begin, int i1end, int i2, int * parents, T * dists)
+{
+  T best [VSIZE] ;
+  T bestOffset [VSIZE] ;
+  int width = 2*tR + 1 ;
+  int i1, o, k, l ;
+
+  for (i1 = i1begin ; i1 < i1end ; i1 += VSIZE) {
+    VTYPE E0 = VLOADU(E + i1 + N1 * i2) ;
+    VTYPE dBest = VSET1(T_INF) ;
+    /* The best neighbor of each lane, as the offset (d1 + tR) + width * (d2 + tR) */
+    VTYPE oBest = VSET1((T) (tR + width * tR)) ;
+
+    for (o = 0 ; o < numOffsets ; ++o) {
+      int d1 = offsets [2*o] ;
+      int d2 = offsets [2*o+1] ;
+      int j2 = i2 + d2 ;
+      VTYPE spatial = VSET1((T) (d1*d1 + d2*d2)) ;
+      VTYPE dist, code ;
+      VMASK higher, better ;
+
+      /* The offsets are sorted by spatial distance: stop once it exceeds the best distance of every lane */
+      if (! VANY(VCMPLE(spatial, dBest))) break ;
+      if (j2 < 0 || j2 >= N2) continue ;
+      higher = VCMPGT(VLOADU(E + i1 + d1 + N1 * j2), E0) ;
+      if (! VANY(higher)) continue ;
+
+      dist = spatial ;
+      for (k = 0 ; k < K ; ++k) {
+        T const * plane = P + S * k ;
+        VTYPE d = VSUB(VLOADU(plane + i1 + N1 * i2),
+                       VLOADU(plane + i1 + d1 + N1 * j2)) ;
+        dist = VADD(dist, VMUL(d, d)) ;
+      }
+      /* Ties go to the smaller offset, i.e. the smaller pixel index */
+      code = VSET1((T) ((d1 + tR) + width * (d2 + tR))) ;
+      better = VAND(higher, VAND(VCMPLE(dist, VSET1(tau2)),
+                                 VOR(VCMPLT(dist, dBest),
+                                     VAND(VCMPLE(dist, dBest), VCMPLT(code, oBest))))) ;
+      dBest = VBLEND(dBest, dist, better) ;
+      oBest = VBLEND(oBest, code, better) ;
+    }
+
+    VSTOREU(best, dBest) ;
+    VSTOREU(bestOffset, oBest) ;
+    for (l = 0 ; l < VSIZE ; ++l) {
+      int offset = (int) bestOffset [l] ;
+      int o1 = offset % width - tR ;
+      int o2 = offset / width - tR ;
+      parents [i1 + l + N1 * i2] = (i1 + l + o1) + N1 * (i2 + o2) ;
+      dists [i1 + l + N1 * i2] = T_SQRT(best [l]) ;
+    }
+  }
+}
+
+/** @internal @brief Medoid shift density and votes of a run of pixels (see ::_VlQSMedoidDensityRow_f) */
+
+void
+VL_XCAT(_vl_quickshift_medoid_density_row_, SFX)
+(T const * P, vl_size S, int N1, int N2, int K, int R,
+ T const * spatialWeights, T const * expTable, T scale,
+ int i1begin, int i1end, int i2, T * E, T * M)
+{
+  T x [VSIZE] ;
+  T w [VSIZE] ;
+  T offsets [VSIZE] ;
+  vl_size MS = (vl_size) N1 * N2 ;
+  int j2min = VL_MAX(i2 - R, 0   ) ;
+  int j2max = VL_MIN(i2 + R, N2-1) ;
+  int i1, j2, d1, k, l ;
+  VTYPE lane ;
+
+  for (l = 0 ; l < VSIZE ; ++l) {
+    offsets [l] = (T) l ;
+  }
+  lane = VLOADU(offsets) ;
+
+  for (i1 = i1begin ; i1 < i1end ; i1 += VSIZE) {
+    /* The votes of the run are the same few cache lines for the whole window */
+    T * votes = M + i1 + N1 * i2 ;
+    VTYPE density = VSET1(0) ;
+    for (j2 = j2min ; j2 <= j2max ; ++ j2) {
+      T const * spatialRow = spatialWeights + (2*R+1) * (j2 - i2 + R) + R ;
+      VTYPE v2 = VSET1((T) j2) ;
+      for (d1 = -R ; d1 <= R ; ++ d1) {
+        VTYPE dist = VSET1(0) ;
+        VTYPE F, v1 ;
+        if (spatialRow [d1] == 0) continue ;
+        for (k = 0 ; k < K ; ++k) {
+          T const * plane = P + S * k ;
+          VTYPE d = VSUB(VLOADU(plane + i1 + N1 * i2),
+                         VLOADU(plane + i1 + d1 + N1 * j2)) ;
+          dist = VADD(dist, VMUL(d, d)) ;
+        }
+        VSTOREU(x, VMUL(dist, VSET1(scale))) ;
+        for (l = 0 ; l < VSIZE ; ++l) {
+          w [l] = expTable ? T_TABLE_EXP(expTable, x [l]) : T_EXP(- x [l]) ;
+        }
+        /* F_ij = - spatial * color and E_i -= F_ij, as the scalar code */
+        F = VMUL(VSET1(- spatialRow [d1]), VLOADU(w)) ;
+        density = VSUB(density, F) ;
+
+        v1 = VADD(VSET1((T) (i1 + d1)), lane) ;
+        VSTOREU(votes, VADD(VLOADU(votes), VMUL(v1, F))) ;
+        VSTOREU(votes + MS, VADD(VLOADU(votes + MS), VMUL(v2, F))) ;
+        for (k = 0 ; k < K ; ++k) {
+          T * plane = votes + MS * (k + 2) ;
+          VSTOREU(plane, VADD(VLOADU(plane),
+                              VMUL(VLOADU(P + S * k + i1 + d1 + N1 * j2), F))) ;
+        }
+      }
+    }
+    VSTOREU(E + i1 + N1 * i2, density) ;
+  }
+}
+
+/** @internal @brief Medoid shift parents of a run of pixels (see ::_VlQSMedoidParentsRow_f) */
+
+void
+VL_XCAT(_vl_quickshift_medoid_parents_row_, SFX)
+(T const * P, vl_size S, int N1, int N2, int K, int R,
+ T const * E, T const * M, T const * n,
+ int i1begin, int i1end, int i2, int * parents, T * dists)
+{
+  T best [VSIZE] ;
+  T bestOffset [VSIZE] ;
+  T offsets [VSIZE] ;
+  vl_size MS = (vl_size) N1 * N2 ;
+  int j2min = VL_MAX(i2 - R, 0   ) ;
+  int j2max = VL_MIN(i2 + R, N2-1) ;
+  int width = 2*R + 1 ;
+  int i1, j2, d1, k, l ;
+  VTYPE lane2 ;
+
+  for (l = 0 ; l < VSIZE ; ++l) {
+    offsets [l] = (T) (2 * l) ;
+  }
+  lane2 = VLOADU(offsets) ;
+
+  for (i1 = i1begin ; i1 < i1end ; i1 += VSIZE) {
+    T const * votes = M + i1 + N1 * i2 ;
+    VTYPE E0 = VLOADU(E + i1 + N1 * i2) ;
+    VTYPE sBest = VSET1(0) ;
+    /* The best neighbor of each lane, as the offset (d1 + R) + width * (d2 + R) */
+    VTYPE oBest = VSET1((T) (R + width * R)) ;
+
+    for (j2 = j2min ; j2 <= j2max ; ++ j2) {
+      int d2 = j2 - i2 ;
+      VTYPE w2 = VSET1((T) (2 * j2)) ;
+      for (d1 = -R ; d1 <= R ; ++ d1) {
+        int j = i1 + d1 + N1 * j2 ;
+        VTYPE Q = VMUL(VMUL(VSET1(-1), VLOADU(n + j)), E0) ;
+        VMASK better ;
+
+        /* Q_ij = - n_j E_i - 2 (j1, j2, I_j) . M_i, term by term as the scalar code */
+        Q = VSUB(Q, VMUL(VADD(VSET1((T) (2 * (i1 + d1))), lane2), VLOADU(votes))) ;
+        Q = VSUB(Q, VMUL(w2, VLOADU(votes + MS))) ;
+        for (k = 0 ; k < K ; ++k) {
+          Q = VSUB(Q, VMUL(VMUL(VSET1(2), VLOADU(P + S * k + j)),
+                           VLOADU(votes + MS * (k + 2)))) ;
+        }
+        better = VCMPGT(Q, sBest) ;
+        sBest = VBLEND(sBest, Q, better) ;
+        oBest = VBLEND(oBest, VSET1((T) ((d1 + R) + width * (d2 + R))), better) ;
+      }
+    }
+
+    VSTOREU(best, sBest) ;
+    VSTOREU(bestOffset, oBest) ;
+    for (l = 0 ; l < VSIZE ; ++l) {
+      int offset = (int) bestOffset [l] ;
+      int o1 = offset % width - R ;
+      int o2 = offset / width - R ;
+      parents [i1 + l + N1 * i2] = (i1 + l + o1) + N1 * (i2 + o2) ;
+      dists [i1 + l + N1 * i2] = best [l] ;
+    }
+  }
+}
@@ -0,0 +1,107 @@
+/** @internal
+ ** @file     quickshift_sse2.c
+ ** @brief    Quick shift SIMD row kernels - SSE2
+ **
+ ** Compiled with SSE2 enabled; only called when the CPU supports it
+ ** (see quickshift_kernels.h).
+ **/
+
+#ifndef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+#include "quickshift_kernels.h"
+#include "mathop.h"
+
+#include <math.h>
+
+#ifndef VL_DISABLE_SSE2
+#include <emmintrin.h>
+
+#define FLT VL_TYPE_FLOAT
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_sse2.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define VL_QUICKSHIFT_SIMD_INSTANTIATING
+#include "quickshift_sse2.c"
+#endif
+
+/* ! VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#else
+
+#if (FLT == VL_TYPE_FLOAT)
+#  define T float
+#  define SFX sse2_f
+#  define T_INF VL_INFINITY_F
+#  define T_EXP expf
+#  define T_SQRT sqrtf
+#  define T_TABLE_EXP _vl_quickshift_table_exp_f
+#  define VTYPE __m128
+#  define VSIZE 4
+#  define VMASK __m128
+#  define VLOADU _mm_loadu_ps
+#  define VSTOREU _mm_storeu_ps
+#  define VSET1 _mm_set1_ps
+#  define VADD _mm_add_ps
+#  define VSUB _mm_sub_ps
+#  define VMUL _mm_mul_ps
+#  define VCMPGT _mm_cmpgt_ps
+#  define VCMPLE _mm_cmple_ps
+#  define VCMPLT _mm_cmplt_ps
+#  define VAND _mm_and_ps
+#  define VOR _mm_or_ps
+#  define VBLEND(a,b,m) _mm_or_ps(_mm_andnot_ps(m,a), _mm_and_ps(m,b))
+#  define VANY _mm_movemask_ps
+#else
+#  define T double
+#  define SFX sse2_d
+#  define T_INF VL_INFINITY_D
+#  define T_EXP exp
+#  define T_SQRT sqrt
+#  define T_TABLE_EXP _vl_quickshift_table_exp_d
+#  define VTYPE __m128d
+#  define VSIZE 2
+#  define VMASK __m128d
+#  define VLOADU _mm_loadu_pd
+#  define VSTOREU _mm_storeu_pd
+#  define VSET1 _mm_set1_pd
+#  define VADD _mm_add_pd
+#  define VSUB _mm_sub_pd
+#  define VMUL _mm_mul_pd
+#  define VCMPGT _mm_cmpgt_pd
+#  define VCMPLE _mm_cmple_pd
+#  define VCMPLT _mm_cmplt_pd
+#  define VAND _mm_and_pd
+#  define VOR _mm_or_pd
+#  define VBLEND(a,b,m) _mm_or_pd(_mm_andnot_pd(m,a), _mm_and_pd(m,b))
+#  define VANY _mm_movemask_pd
+#endif
+
+#include "quickshift_simd.h"
+
+#undef T
+#undef SFX
+#undef T_INF
+#undef T_EXP
+#undef T_SQRT
+#undef T_TABLE_EXP
+#undef VTYPE
+#undef VSIZE
+#undef VMASK
+#undef VLOADU
+#undef VSTOREU
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VCMPGT
+#undef VCMPLE
+#undef VCMPLT
+#undef VAND
+#undef VOR
+#undef VBLEND
+#undef VANY
+#undef FLT
+#undef VL_QUICKSHIFT_SIMD_INSTANTIATING
+
+/* VL_QUICKSHIFT_SIMD_INSTANTIATING */
+#endif
@@ -0,0 +1,75 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef REGIONADJACENCYGRAPH_H
+#define REGIONADJACENCYGRAPH_H
+
+// STL
+#include <cstddef>
+#include <vector>
+
+// The regions of a label image and which of them touch (4-connectivity), in compressed sparse row form. The regions
+// are the labels 0 to NumberOfRegions - 1, as given by the segmentation filters (see Helpers::RelabelSequential()).
+//
+// Every pair of touching regions is one edge, numbered in order of (smaller region, larger region). The neighbors of
+// region r are Neighbors[Offsets[r]] to Neighbors[Offsets[r+1] - 1], in increasing order, and EdgeIds gives the edge
+// of each of them, so that each edge appears in the rows of both its regions.
+class RegionAdjacencyGraph
+{
+public:
+  RegionAdjacencyGraph() : NumberOfRegions(0) {}
+
+  // Build the graph of 'labelImage', with the colors of 'image' for the color differences. The labels must be below
+  // numberOfLabels; 0 finds the count from the largest label.
+  template<typename TImage, typename TLabelImage>
+  void Build(const TImage* image, const TLabelImage* labelImage, unsigned int numberOfLabels = 0);
+
+  // Empty the graph.
+  void Clear();
+
+  unsigned int GetNumberOfEdges() const
+  {
+    return static_cast<unsigned int>(this->EdgeSources.size());
+  }
+
+  unsigned int GetDegree(const unsigned int region) const
+  {
+    return static_cast<unsigned int>(this->Offsets[region + 1] - this->Offsets[region]);
+  }
+
+  unsigned int NumberOfRegions;
+
+  // Rows of the adjacency: NumberOfRegions + 1 offsets into Neighbors and EdgeIds.
+  std::vector<std::size_t> Offsets;
+  std::vector<unsigned int> Neighbors;
+  std::vector<unsigned int> EdgeIds;
+
+  // The regions of each edge, the smaller one first.
+  std::vector<unsigned int> EdgeSources;
+  std::vector<unsigned int> EdgeTargets;
+
+  // Number of pairs of neighboring pixels across each edge, i.e. the length of the boundary in pixel sides.
+  std::vector<std::size_t> BoundaryLengths;
+
+  // Average over those pairs of the (Euclidean) distance between the colors of the two pixels.
+  std::vector<double> ColorDifferences;
+};
+
+#include "RegionAdjacencyGraph.hxx"
+
+#endif
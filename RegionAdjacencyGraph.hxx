@@ -0,0 +1,278 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// ITK
+#include "itkImageRegion.h"
+#include "itkMultiThreader.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+
+// A pair of touching regions (the smaller one first), with the sums over the pairs of pixels found across it.
+struct RegionAdjacencyRecord
+{
+  unsigned int Source;
+  unsigned int Target;
+  std::size_t Length;
+  double Difference;
+
+  bool operator<(const RegionAdjacencyRecord& other) const
+  {
+    return this->Source < other.Source || (this->Source == other.Source && this->Target < other.Target);
+  }
+
+  bool SameRegions(const RegionAdjacencyRecord& other) const
+  {
+    return this->Source == other.Source && this->Target == other.Target;
+  }
+};
+
+// Add up the records of the same regions, which must be next to each other (e.g. once sorted), in place.
+inline void ReduceRegionAdjacencyRecords(std::vector<RegionAdjacencyRecord>& records, const bool sort)
+{
+  if(sort)
+    {
+    std::sort(records.begin(), records.end());
+    }
+  std::size_t unique = 0;
+  for(std::size_t i = 0; i < records.size(); ++i)
+    {
+    if(unique > 0 && records[unique - 1].SameRegions(records[i]))
+      {
+      records[unique - 1].Length += records[i].Length;
+      records[unique - 1].Difference += records[i].Difference;
+      }
+    else
+      {
+      records[unique++] = records[i];
+      }
+    }
+  records.resize(unique);
+}
+
+// State shared by the threads of RegionAdjacencyGraph::Build(). The image is split into one run of rows per thread,
+// and each run lists the pairs of regions it sees on its own.
+template<typename TComponent, typename TLabel>
+struct RegionAdjacencyData
+{
+  const TComponent* Image;
+  const TLabel* Labels;
+  long Width;
+  long Height;
+  unsigned int NumberOfComponents;
+  unsigned int NumberOfRuns;
+
+  std::vector<std::vector<RegionAdjacencyRecord> > Runs;
+
+  double ColorDistance(const TComponent* a, const TComponent* b) const
+  {
+    double distance = 0;
+    for(unsigned int component = 0; component < this->NumberOfComponents; ++component)
+      {
+      const double difference = static_cast<double>(a[component]) - static_cast<double>(b[component]);
+      distance += difference * difference;
+      }
+    return std::sqrt(distance);
+  }
+
+  // Count a pair of neighboring pixels of regions a and b. A boundary crosses the same two regions for many pixels
+  // in a row, so the pair goes to the record of the previous one (of the same direction) if it can.
+  static void AddPair(std::vector<RegionAdjacencyRecord>& records, std::size_t& last, const TLabel a, const TLabel b,
+                      const double difference)
+  {
+    RegionAdjacencyRecord record;
+    record.Source = static_cast<unsigned int>(std::min(a, b));
+    record.Target = static_cast<unsigned int>(std::max(a, b));
+    if(last < records.size() && records[last].SameRegions(record))
+      {
+      records[last].Length++;
+      records[last].Difference += difference;
+      return;
+      }
+    record.Length = 1;
+    record.Difference = difference;
+    last = records.size();
+    records.push_back(record);
+  }
+
+  void Scan(const unsigned int run)
+  {
+    const long rowBegin = this->Height * run / this->NumberOfRuns;
+    const long rowEnd = this->Height * (run + 1) / this->NumberOfRuns;
+    const long width = this->Width;
+    const unsigned int components = this->NumberOfComponents;
+    std::vector<RegionAdjacencyRecord>& records = this->Runs[run];
+    std::size_t lastHorizontal = static_cast<std::size_t>(-1);
+    std::size_t lastVertical = static_cast<std::size_t>(-1);
+
+    for(long y = rowBegin; y < rowEnd; ++y)
+      {
+      const TLabel* labels = this->Labels + y * width;
+      const TComponent* pixel = this->Image + y * width * components;
+      for(long x = 0; x < width; ++x, pixel += components)
+        {
+        // The pixel on the right and the one below, which may be in the next run but is only read.
+        if(x + 1 < width && labels[x + 1] != labels[x])
+          {
+          AddPair(records, lastHorizontal, labels[x], labels[x + 1], ColorDistance(pixel, pixel + components));
+          }
+        if(y + 1 < this->Height && labels[x + width] != labels[x])
+          {
+          AddPair(records, lastVertical, labels[x], labels[x + width], ColorDistance(pixel, pixel + width * components));
+          }
+        }
+      }
+
+    ReduceRegionAdjacencyRecords(records, true);
+  }
+
+  static ITK_THREAD_RETURN_TYPE ThreadFunction(void* arg)
+  {
+    itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+    RegionAdjacencyData* data = static_cast<RegionAdjacencyData*>(threadInfo->UserData);
+    if(threadInfo->ThreadID < data->NumberOfRuns)
+      {
+      data->Scan(threadInfo->ThreadID);
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+};
+
+inline void RegionAdjacencyGraph::Clear()
+{
+  this->NumberOfRegions = 0;
+  this->Offsets.assign(1, 0);
+  this->Neighbors.clear();
+  this->EdgeIds.clear();
+  this->EdgeSources.clear();
+  this->EdgeTargets.clear();
+  this->BoundaryLengths.clear();
+  this->ColorDifferences.clear();
+}
+
+template<typename TImage, typename TLabelImage>
+void RegionAdjacencyGraph::Build(const TImage* image, const TLabelImage* labelImage, unsigned int numberOfLabels)
+{
+  typedef typename TImage::InternalPixelType ComponentType;
+  typedef typename TLabelImage::PixelType LabelType;
+
+  Clear();
+
+  const itk::ImageRegion<2> region = labelImage->GetLargestPossibleRegion();
+  const std::size_t numberOfPixels = region.GetNumberOfPixels();
+  if(numberOfPixels == 0)
+    {
+    return;
+    }
+
+  RegionAdjacencyData<ComponentType, LabelType> data;
+  data.Image = image->GetBufferPointer();
+  data.Labels = labelImage->GetBufferPointer();
+  data.Width = region.GetSize()[0];
+  data.Height = region.GetSize()[1];
+  data.NumberOfComponents = image->GetNumberOfComponentsPerPixel();
+
+  if(numberOfLabels == 0)
+    {
+    numberOfLabels = static_cast<unsigned int>(*std::max_element(data.Labels, data.Labels + numberOfPixels)) + 1;
+    }
+
+  // Runs of at least 64K pixels.
+  const std::size_t minimumRunSize = 65536;
+  std::size_t numberOfRuns = std::min<std::size_t>(itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                                   numberOfPixels / minimumRunSize);
+  numberOfRuns = std::min<std::size_t>(numberOfRuns, data.Height);
+  data.NumberOfRuns = std::max<std::size_t>(1, numberOfRuns);
+  data.Runs.resize(data.NumberOfRuns);
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(data.NumberOfRuns);
+  threader->SetSingleMethod(RegionAdjacencyData<ComponentType, LabelType>::ThreadFunction, &data);
+  threader->SingleMethodExecute();
+
+  // Merge the records of the runs without sorting them all: bucket them by their smaller region and sort each bucket,
+  // which leaves the records of each edge next to each other, in order of (smaller region, larger region).
+  std::vector<std::size_t> bucketOffsets(numberOfLabels + 1, 0);
+  for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+    {
+    for(std::size_t i = 0; i < data.Runs[run].size(); ++i)
+      {
+      bucketOffsets[data.Runs[run][i].Source + 1]++;
+      }
+    }
+  for(unsigned int label = 0; label < numberOfLabels; ++label)
+    {
+    bucketOffsets[label + 1] += bucketOffsets[label];
+    }
+
+  std::vector<RegionAdjacencyRecord> records(bucketOffsets[numberOfLabels]);
+  std::vector<std::size_t> cursors(bucketOffsets.begin(), bucketOffsets.end() - 1);
+  for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+    {
+    for(std::size_t i = 0; i < data.Runs[run].size(); ++i)
+      {
+      records[cursors[data.Runs[run][i].Source]++] = data.Runs[run][i];
+      }
+    std::vector<RegionAdjacencyRecord>().swap(data.Runs[run]);
+    }
+
+  this->NumberOfRegions = numberOfLabels;
+  this->EdgeSources.reserve(records.size());
+  this->EdgeTargets.reserve(records.size());
+  this->BoundaryLengths.reserve(records.size());
+  this->ColorDifferences.reserve(records.size());
+  for(unsigned int label = 0; label < numberOfLabels; ++label)
+    {
+    std::sort(records.begin() + bucketOffsets[label], records.begin() + bucketOffsets[label + 1]);
+    }
+  ReduceRegionAdjacencyRecords(records, false);
+  for(std::size_t i = 0; i < records.size(); ++i)
+    {
+    this->EdgeSources.push_back(records[i].Source);
+    this->EdgeTargets.push_back(records[i].Target);
+    this->BoundaryLengths.push_back(records[i].Length);
+    this->ColorDifferences.push_back(records[i].Difference / records[i].Length);
+    }
+
+  // The rows of both regions of each edge. Taking the edges in order fills every row in increasing order of neighbor.
+  const unsigned int numberOfEdges = GetNumberOfEdges();
+  this->Offsets.assign(numberOfLabels + 1, 0);
+  for(unsigned int edge = 0; edge < numberOfEdges; ++edge)
+    {
+    this->Offsets[this->EdgeSources[edge] + 1]++;
+    this->Offsets[this->EdgeTargets[edge] + 1]++;
+    }
+  for(unsigned int label = 0; label < numberOfLabels; ++label)
+    {
+    this->Offsets[label + 1] += this->Offsets[label];
+    }
+
+  this->Neighbors.resize(2 * numberOfEdges);
+  this->EdgeIds.resize(2 * numberOfEdges);
+  cursors.assign(this->Offsets.begin(), this->Offsets.end() - 1);
+  for(unsigned int edge = 0; edge < numberOfEdges; ++edge)
+    {
+    const unsigned int source = this->EdgeSources[edge];
+    const unsigned int target = this->EdgeTargets[edge];
+    this->Neighbors[cursors[source]] = target;
+    this->EdgeIds[cursors[source]++] = edge;
+    this->Neighbors[cursors[target]] = source;
+    this->EdgeIds[cursors[target]++] = edge;
+    }
+}
@@ -0,0 +1,66 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef REGIONMERGING_H
+#define REGIONMERGING_H
+
+// Custom
+#include "RegionAdjacencyGraph.h"
+#include "RegionStatistics.h"
+
+// STL
+#include <cstddef>
+#include <vector>
+
+// Greedy agglomerative merging of the regions of a label image: the two touching regions with the closest mean
+// colors are merged, their mean color is updated, and so on until the requested number of regions is left. The work
+// is on the region adjacency graph (RegionAdjacencyGraph) and the statistics (RegionStatistics) of the regions, so it
+// does not depend on the number of pixels.
+//
+// Every merge is recorded as a dendrogram, in the form of scipy's linkage matrix: the regions are the clusters 0 to
+// NumberOfRegions - 1, and merge i makes cluster NumberOfRegions + i.
+class RegionMerging
+{
+public:
+  RegionMerging() : NumberOfRegions(0), FinalNumberOfRegions(0) {}
+
+  // Merge the regions of 'graph' until 'numberOfRegions' are left, or until no two regions touch; 1 gives the whole
+  // dendrogram. 'statistics' must have the PixelCount and MeanColor of the same regions; otherwise nothing is merged
+  // and false is returned. Regions without pixels are not merged.
+  bool Merge(const RegionAdjacencyGraph& graph, const RegionStatistics& statistics, const unsigned int numberOfRegions);
+
+  // Set each pixel of 'output' to the merged label of its region in 'input'. The input may be the output.
+  template<typename TLabelImage>
+  void Relabel(const TLabelImage* input, TLabelImage* output) const;
+
+  unsigned int NumberOfRegions;
+  unsigned int FinalNumberOfRegions;
+
+  // Label of each region after merging, 0 to FinalNumberOfRegions - 1 in order of the smallest region of each.
+  std::vector<unsigned int> RegionLabels;
+
+  // The two clusters of each merge, the distance between their mean colors, and the pixels of the new cluster.
+  std::vector<unsigned int> MergeFirst;
+  std::vector<unsigned int> MergeSecond;
+  std::vector<double> MergeCosts;
+  std::vector<std::size_t> MergeSizes;
+};
+
+#include "RegionMerging.hxx"
+
+#endif
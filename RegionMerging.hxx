@@ -0,0 +1,284 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+// A candidate merge of two regions in the queue of RegionMerging::Merge(). It is out of date once either region has
+// been merged since (its version changed), and is then dropped when it comes out of the queue.
+struct RegionMergeCandidate
+{
+  double Cost;
+  unsigned int First;
+  unsigned int Second;
+  unsigned int FirstVersion;
+  unsigned int SecondVersion;
+
+  // Ordered so that std::push_heap() keeps the cheapest candidate on top, ties going to the smaller regions.
+  bool operator>(const RegionMergeCandidate& other) const
+  {
+    if(this->Cost != other.Cost)
+      {
+      return this->Cost > other.Cost;
+      }
+    if(this->First != other.First)
+      {
+      return this->First > other.First;
+      }
+    return this->Second > other.Second;
+  }
+};
+
+// The regions being merged: a union-find over the regions, whose roots hold the statistics of their cluster. Regions
+// without pixels have no mean color, so they are left out of the neighbors and never merged.
+class RegionMergingForest
+{
+public:
+  RegionMergingForest(const RegionAdjacencyGraph& graph, const RegionStatistics& statistics)
+    : Components(statistics.NumberOfComponents), Parents(graph.NumberOfRegions), Versions(graph.NumberOfRegions, 0),
+      Clusters(graph.NumberOfRegions), PixelCounts(statistics.PixelCounts),
+      ColorSums(statistics.MeanColors), Neighbors(graph.NumberOfRegions), Marks(graph.NumberOfRegions, 0), Mark(0)
+  {
+    for(unsigned int region = 0; region < graph.NumberOfRegions; ++region)
+      {
+      this->Parents[region] = region;
+      this->Clusters[region] = region;
+      for(unsigned int component = 0; component < this->Components; ++component)
+        {
+        this->ColorSums[region * this->Components + component] *= this->PixelCounts[region];
+        }
+      if(this->PixelCounts[region] == 0)
+        {
+        continue;
+        }
+      for(std::size_t i = graph.Offsets[region]; i < graph.Offsets[region + 1]; ++i)
+        {
+        if(this->PixelCounts[graph.Neighbors[i]] > 0)
+          {
+          this->Neighbors[region].push_back(graph.Neighbors[i]);
+          }
+        }
+      }
+  }
+
+  bool IsEmpty(const unsigned int region) const
+  {
+    return this->PixelCounts[region] == 0;
+  }
+
+  unsigned int Find(unsigned int region)
+  {
+    // Path halving
+    while(this->Parents[region] != region)
+      {
+      this->Parents[region] = this->Parents[this->Parents[region]];
+      region = this->Parents[region];
+      }
+    return region;
+  }
+
+  // Distance between the mean colors of two roots.
+  double Cost(const unsigned int a, const unsigned int b) const
+  {
+    const double* sumA = &this->ColorSums[a * this->Components];
+    const double* sumB = &this->ColorSums[b * this->Components];
+    double distance = 0;
+    for(unsigned int component = 0; component < this->Components; ++component)
+      {
+      const double difference = sumA[component] / this->PixelCounts[a] - sumB[component] / this->PixelCounts[b];
+      distance += difference * difference;
+      }
+    return std::sqrt(distance);
+  }
+
+  RegionMergeCandidate Candidate(const unsigned int a, const unsigned int b) const
+  {
+    RegionMergeCandidate candidate;
+    candidate.Cost = Cost(a, b);
+    candidate.First = std::min(a, b);
+    candidate.Second = std::max(a, b);
+    candidate.FirstVersion = this->Versions[candidate.First];
+    candidate.SecondVersion = this->Versions[candidate.Second];
+    return candidate;
+  }
+
+  bool IsCurrent(const RegionMergeCandidate& candidate) const
+  {
+    return this->Parents[candidate.First] == candidate.First && this->Parents[candidate.Second] == candidate.Second &&
+           this->Versions[candidate.First] == candidate.FirstVersion &&
+           this->Versions[candidate.Second] == candidate.SecondVersion;
+  }
+
+  // Merge two roots into the one with more pixels, which is returned.
+  unsigned int Union(unsigned int a, unsigned int b, const unsigned int cluster)
+  {
+    if(this->PixelCounts[a] < this->PixelCounts[b])
+      {
+      std::swap(a, b);
+      }
+    this->Parents[b] = a;
+    this->Versions[a]++;
+    this->Clusters[a] = cluster;
+    this->PixelCounts[a] += this->PixelCounts[b];
+    for(unsigned int component = 0; component < this->Components; ++component)
+      {
+      this->ColorSums[a * this->Components + component] += this->ColorSums[b * this->Components + component];
+      }
+
+    // The shorter list of neighbors goes into the longer one.
+    if(this->Neighbors[a].size() < this->Neighbors[b].size())
+      {
+      this->Neighbors[a].swap(this->Neighbors[b]);
+      }
+    this->Neighbors[a].insert(this->Neighbors[a].end(), this->Neighbors[b].begin(), this->Neighbors[b].end());
+    std::vector<unsigned int>().swap(this->Neighbors[b]);
+    return a;
+  }
+
+  // Replace the neighbors of a root by their roots, without itself or repeats, and add the candidate merges with
+  // each of them to the queue.
+  void UpdateNeighbors(const unsigned int root, std::vector<RegionMergeCandidate>& queue)
+  {
+    std::vector<unsigned int>& neighbors = this->Neighbors[root];
+    this->Mark++;
+    this->Marks[root] = this->Mark;
+    std::size_t count = 0;
+    for(std::size_t i = 0; i < neighbors.size(); ++i)
+      {
+      const unsigned int neighbor = Find(neighbors[i]);
+      if(this->Marks[neighbor] == this->Mark)
+        {
+        continue;
+        }
+      this->Marks[neighbor] = this->Mark;
+      neighbors[count++] = neighbor;
+      queue.push_back(Candidate(root, neighbor));
+      std::push_heap(queue.begin(), queue.end(), std::greater<RegionMergeCandidate>());
+      }
+    neighbors.resize(count);
+  }
+
+  unsigned int Components;
+  std::vector<unsigned int> Parents;
+  std::vector<unsigned int> Versions;
+  std::vector<unsigned int> Clusters; // dendrogram cluster of each root
+  std::vector<std::size_t> PixelCounts;
+  std::vector<double> ColorSums; // Components per region
+  std::vector<std::vector<unsigned int> > Neighbors; // of each root, possibly stale until UpdateNeighbors()
+  std::vector<unsigned int> Marks;
+  unsigned int Mark;
+};
+
+inline bool RegionMerging::Merge(const RegionAdjacencyGraph& graph, const RegionStatistics& statistics,
+                                 const unsigned int numberOfRegions)
+{
+  this->NumberOfRegions = graph.NumberOfRegions;
+  this->MergeFirst.clear();
+  this->MergeSecond.clear();
+  this->MergeCosts.clear();
+  this->MergeSizes.clear();
+
+  if(!(statistics.Statistics & RegionStatistics::MeanColor) || statistics.NumberOfLabels != graph.NumberOfRegions)
+    {
+    std::cerr << "RegionMerging::Merge(): the statistics need the MeanColor of the " << graph.NumberOfRegions
+              << " regions of the graph." << std::endl;
+    this->FinalNumberOfRegions = graph.NumberOfRegions;
+    this->RegionLabels.resize(graph.NumberOfRegions);
+    for(unsigned int region = 0; region < graph.NumberOfRegions; ++region)
+      {
+      this->RegionLabels[region] = region;
+      }
+    return false;
+    }
+
+  RegionMergingForest forest(graph, statistics);
+
+  // One candidate per edge to start with.
+  std::vector<RegionMergeCandidate> queue;
+  queue.reserve(2 * graph.GetNumberOfEdges());
+  for(unsigned int edge = 0; edge < graph.GetNumberOfEdges(); ++edge)
+    {
+    if(!forest.IsEmpty(graph.EdgeSources[edge]) && !forest.IsEmpty(graph.EdgeTargets[edge]))
+      {
+      queue.push_back(forest.Candidate(graph.EdgeSources[edge], graph.EdgeTargets[edge]));
+      }
+    }
+  std::make_heap(queue.begin(), queue.end(), std::greater<RegionMergeCandidate>());
+
+  // Each merge changes the mean color of the new region, so its candidates with all its neighbors are queued again;
+  // the old ones are dropped as they come out.
+  unsigned int regionsLeft = graph.NumberOfRegions;
+  while(regionsLeft > numberOfRegions && !queue.empty())
+    {
+    std::pop_heap(queue.begin(), queue.end(), std::greater<RegionMergeCandidate>());
+    const RegionMergeCandidate candidate = queue.back();
+    queue.pop_back();
+    if(!forest.IsCurrent(candidate))
+      {
+      continue;
+      }
+
+    this->MergeFirst.push_back(forest.Clusters[candidate.First]);
+    this->MergeSecond.push_back(forest.Clusters[candidate.Second]);
+    this->MergeCosts.push_back(candidate.Cost);
+    const unsigned int root = forest.Union(candidate.First, candidate.Second,
+                                           graph.NumberOfRegions + static_cast<unsigned int>(this->MergeCosts.size()) - 1);
+    this->MergeSizes.push_back(forest.PixelCounts[root]);
+    regionsLeft--;
+
+    forest.UpdateNeighbors(root, queue);
+    }
+
+  // Number the clusters in order of their smallest region.
+  this->FinalNumberOfRegions = 0;
+  this->RegionLabels.assign(graph.NumberOfRegions, 0);
+  std::vector<unsigned int> rootLabels(graph.NumberOfRegions, graph.NumberOfRegions);
+  for(unsigned int region = 0; region < graph.NumberOfRegions; ++region)
+    {
+    const unsigned int root = forest.Find(region);
+    if(rootLabels[root] == graph.NumberOfRegions)
+      {
+      rootLabels[root] = this->FinalNumberOfRegions++;
+      }
+    this->RegionLabels[region] = rootLabels[root];
+    }
+  return true;
+}
+
+template<typename TLabelImage>
+void RegionMerging::Relabel(const TLabelImage* input, TLabelImage* output) const
+{
+  typedef typename TLabelImage::PixelType LabelType;
+
+  if(input != output)
+    {
+    output->SetRegions(input->GetLargestPossibleRegion());
+    output->Allocate();
+    }
+
+  const std::size_t numberOfPixels = input->GetLargestPossibleRegion().GetNumberOfPixels();
+  const LabelType* labels = input->GetBufferPointer();
+  LabelType* merged = output->GetBufferPointer();
+  for(std::size_t i = 0; i < numberOfPixels; ++i)
+    {
+    merged[i] = static_cast<LabelType>(this->RegionLabels[static_cast<std::size_t>(labels[i])]);
+    }
+}
@@ -0,0 +1,111 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef REGIONSTATISTICS_H
+#define REGIONSTATISTICS_H
+
+// STL
+#include <cstddef>
+#include <vector>
+
+// Features of every superpixel of a label image, computed in one multi-threaded pass over the image and label buffers.
+// The table is a structure of arrays indexed by label: the labels are 0 to NumberOfLabels - 1, as given by the
+// segmentation filters (see Helpers::RelabelSequential()). Only the arrays of the statistics asked for are filled;
+// the others are empty.
+class RegionStatistics
+{
+public:
+  // The statistics Compute() can be asked for, to be or-ed together.
+  enum Statistic
+    {
+    PixelCount = 1,      // PixelCounts (always computed)
+    MeanColor = 2,       // MeanColors
+    ColorCovariance = 4, // ColorCovariances
+    Centroid = 8,        // CentroidsX, CentroidsY
+    BoundingBox = 16,    // MinimumX, MinimumY, MaximumX, MaximumY
+    Perimeter = 32,      // Perimeters
+    ColorHistogram = 64, // ColorHistograms
+    AllStatistics = 127
+    };
+
+  RegionStatistics() : NumberOfLabels(0), NumberOfComponents(0), Statistics(0), HistogramBins(16),
+                       HistogramMinimum(0), HistogramMaximum(256) {}
+
+  // Compute 'statistics' for every label of 'labelImage', with the colors of 'image'. The labels must be below
+  // numberOfLabels; 0 finds the count from the largest label. The histogram settings are kept.
+  template<typename TImage, typename TLabelImage>
+  void Compute(const TImage* image, const TLabelImage* labelImage, const unsigned int statistics,
+               unsigned int numberOfLabels = 0);
+
+  // Empty the table.
+  void Clear();
+
+  // Number of bins of the histogram of each channel, spread evenly over [HistogramMinimum, HistogramMaximum).
+  // Values outside the range go to the first or last bin, and a range with maximum <= minimum is taken as
+  // [minimum, minimum + 1). 16 bins over [0, 256) by default.
+  void SetHistogramBins(const unsigned int bins)
+  {
+    this->HistogramBins = bins;
+  }
+
+  void SetHistogramRange(const double minimum, const double maximum)
+  {
+    this->HistogramMinimum = minimum;
+    this->HistogramMaximum = maximum;
+  }
+
+  unsigned int NumberOfLabels;
+  unsigned int NumberOfComponents;
+
+  // The statistics of the last Compute().
+  unsigned int Statistics;
+
+  unsigned int HistogramBins;
+  double HistogramMinimum;
+  double HistogramMaximum;
+
+  // Number of pixels of each label.
+  std::vector<std::size_t> PixelCounts;
+
+  // Average color, NumberOfComponents per label.
+  std::vector<double> MeanColors;
+
+  // Covariance matrix of the colors (over the pixels, not the sample covariance), NumberOfComponents^2 per label in
+  // row major order.
+  std::vector<double> ColorCovariances;
+
+  // Average pixel index.
+  std::vector<double> CentroidsX;
+  std::vector<double> CentroidsY;
+
+  // Smallest and largest pixel index, inclusive. Labels without pixels have a minimum above their maximum.
+  std::vector<long> MinimumX;
+  std::vector<long> MinimumY;
+  std::vector<long> MaximumX;
+  std::vector<long> MaximumY;
+
+  // Number of pixel sides between the label and another label or the image border (4-connectivity).
+  std::vector<std::size_t> Perimeters;
+
+  // Histogram of each channel, NumberOfComponents * HistogramBins per label (the bins of channel 0 first).
+  std::vector<std::size_t> ColorHistograms;
+};
+
+#include "RegionStatistics.hxx"
+
+#endif
@@ -0,0 +1,394 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// ITK
+#include "itkImageRegion.h"
+#include "itkMultiThreader.h"
+
+// STL
+#include <algorithm>
+#include <limits>
+
+// The sums of one run of rows of the image, from which the statistics are finished once every run is done.
+struct RegionStatisticsAccumulator
+{
+  std::vector<std::size_t> PixelCounts;
+  std::vector<double> ColorSums; // NumberOfComponents per label
+  std::vector<double> ColorProducts; // NumberOfComponents^2 per label, only the upper triangle
+  std::vector<double> XSums;
+  std::vector<double> YSums;
+  std::vector<long> MinimumX;
+  std::vector<long> MinimumY;
+  std::vector<long> MaximumX;
+  std::vector<long> MaximumY;
+  std::vector<std::size_t> Perimeters;
+  std::vector<std::size_t> ColorHistograms;
+
+  void Allocate(const unsigned int statistics, const std::size_t labels, const std::size_t components,
+                const std::size_t bins)
+  {
+    this->PixelCounts.assign(labels, 0);
+    if(statistics & (RegionStatistics::MeanColor | RegionStatistics::ColorCovariance))
+      {
+      this->ColorSums.assign(labels * components, 0);
+      }
+    if(statistics & RegionStatistics::ColorCovariance)
+      {
+      this->ColorProducts.assign(labels * components * components, 0);
+      }
+    if(statistics & RegionStatistics::Centroid)
+      {
+      this->XSums.assign(labels, 0);
+      this->YSums.assign(labels, 0);
+      }
+    if(statistics & RegionStatistics::BoundingBox)
+      {
+      this->MinimumX.assign(labels, std::numeric_limits<long>::max());
+      this->MinimumY.assign(labels, std::numeric_limits<long>::max());
+      this->MaximumX.assign(labels, std::numeric_limits<long>::min());
+      this->MaximumY.assign(labels, std::numeric_limits<long>::min());
+      }
+    if(statistics & RegionStatistics::Perimeter)
+      {
+      this->Perimeters.assign(labels, 0);
+      }
+    if(statistics & RegionStatistics::ColorHistogram)
+      {
+      this->ColorHistograms.assign(labels * components * bins, 0);
+      }
+  }
+
+  // Add the sums of 'other' to these.
+  void Merge(const RegionStatisticsAccumulator& other)
+  {
+    Add(this->PixelCounts, other.PixelCounts);
+    Add(this->ColorSums, other.ColorSums);
+    Add(this->ColorProducts, other.ColorProducts);
+    Add(this->XSums, other.XSums);
+    Add(this->YSums, other.YSums);
+    Add(this->Perimeters, other.Perimeters);
+    Add(this->ColorHistograms, other.ColorHistograms);
+    for(std::size_t label = 0; label < this->MinimumX.size(); ++label)
+      {
+      this->MinimumX[label] = std::min(this->MinimumX[label], other.MinimumX[label]);
+      this->MinimumY[label] = std::min(this->MinimumY[label], other.MinimumY[label]);
+      this->MaximumX[label] = std::max(this->MaximumX[label], other.MaximumX[label]);
+      this->MaximumY[label] = std::max(this->MaximumY[label], other.MaximumY[label]);
+      }
+  }
+
+  template<typename T>
+  static void Add(std::vector<T>& sums, const std::vector<T>& other)
+  {
+    for(std::size_t i = 0; i < sums.size(); ++i)
+      {
+      sums[i] += other[i];
+      }
+  }
+};
+
+// State shared by the threads of RegionStatistics::Compute(). The image is split into one run of rows per thread.
+template<typename TComponent, typename TLabel>
+struct RegionStatisticsData
+{
+  const TComponent* Image;
+  const TLabel* Labels;
+  long Width;
+  long Height;
+  long OriginX;
+  long OriginY;
+  unsigned int NumberOfComponents;
+  unsigned int Statistics;
+  unsigned int HistogramBins;
+  double HistogramMinimum;
+  double HistogramScale; // bins per unit of color
+  unsigned int NumberOfRuns;
+
+  std::vector<RegionStatisticsAccumulator> Runs;
+
+  void Accumulate(const unsigned int run)
+  {
+    const long rowBegin = this->Height * run / this->NumberOfRuns;
+    const long rowEnd = this->Height * (run + 1) / this->NumberOfRuns;
+    const unsigned int components = this->NumberOfComponents;
+    const unsigned int statistics = this->Statistics;
+    const long bins = this->HistogramBins;
+    const double lastBin = static_cast<double>(bins - 1);
+    RegionStatisticsAccumulator& sums = this->Runs[run];
+
+    for(long y = rowBegin; y < rowEnd; ++y)
+      {
+      const TLabel* labels = this->Labels + y * this->Width;
+      const TComponent* pixel = this->Image + y * this->Width * components;
+      for(long x = 0; x < this->Width; ++x, pixel += components)
+        {
+        const TLabel labelValue = labels[x];
+        const std::size_t label = static_cast<std::size_t>(labelValue);
+        sums.PixelCounts[label]++;
+
+        if(statistics & (RegionStatistics::MeanColor | RegionStatistics::ColorCovariance))
+          {
+          double* colorSums = &sums.ColorSums[label * components];
+          for(unsigned int component = 0; component < components; ++component)
+            {
+            colorSums[component] += pixel[component];
+            }
+          }
+
+        if(statistics & RegionStatistics::ColorCovariance)
+          {
+          double* products = &sums.ColorProducts[label * components * components];
+          for(unsigned int a = 0; a < components; ++a)
+            {
+            const double value = pixel[a];
+            for(unsigned int b = a; b < components; ++b)
+              {
+              products[a * components + b] += value * pixel[b];
+              }
+            }
+          }
+
+        if(statistics & RegionStatistics::Centroid)
+          {
+          sums.XSums[label] += x;
+          sums.YSums[label] += y;
+          }
+
+        if(statistics & RegionStatistics::BoundingBox)
+          {
+          sums.MinimumX[label] = std::min(sums.MinimumX[label], x);
+          sums.MaximumX[label] = std::max(sums.MaximumX[label], x);
+          sums.MinimumY[label] = std::min(sums.MinimumY[label], y);
+          sums.MaximumY[label] = std::max(sums.MaximumY[label], y);
+          }
+
+        if(statistics & RegionStatistics::Perimeter)
+          {
+          // The rows above and below belong to other runs, but are only read.
+          sums.Perimeters[label] += (x == 0 || labels[x - 1] != labelValue) +
+                                    (x == this->Width - 1 || labels[x + 1] != labelValue) +
+                                    (y == 0 || labels[x - this->Width] != labelValue) +
+                                    (y == this->Height - 1 || labels[x + this->Width] != labelValue);
+          }
+
+        if(statistics & RegionStatistics::ColorHistogram)
+          {
+          std::size_t* histogram = &sums.ColorHistograms[label * components * bins];
+          for(unsigned int component = 0; component < components; ++component)
+            {
+            // Clamped before the conversion, which is undefined out of range (and for NaN, which goes to bin 0).
+            double position = (pixel[component] - this->HistogramMinimum) * this->HistogramScale;
+            position = position > 0 ? std::min(position, lastBin) : 0;
+            histogram[component * bins + static_cast<long>(position)]++;
+            }
+          }
+        }
+      }
+  }
+
+  static ITK_THREAD_RETURN_TYPE ThreadFunction(void* arg)
+  {
+    itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+    RegionStatisticsData* data = static_cast<RegionStatisticsData*>(threadInfo->UserData);
+    if(threadInfo->ThreadID < data->NumberOfRuns)
+      {
+      data->Accumulate(threadInfo->ThreadID);
+      }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+};
+
+inline void RegionStatistics::Clear()
+{
+  this->NumberOfLabels = 0;
+  this->NumberOfComponents = 0;
+  this->Statistics = 0;
+  this->PixelCounts.clear();
+  this->MeanColors.clear();
+  this->ColorCovariances.clear();
+  this->CentroidsX.clear();
+  this->CentroidsY.clear();
+  this->MinimumX.clear();
+  this->MinimumY.clear();
+  this->MaximumX.clear();
+  this->MaximumY.clear();
+  this->Perimeters.clear();
+  this->ColorHistograms.clear();
+}
+
+template<typename TImage, typename TLabelImage>
+void RegionStatistics::Compute(const TImage* image, const TLabelImage* labelImage, const unsigned int statistics,
+                               unsigned int numberOfLabels)
+{
+  typedef typename TImage::InternalPixelType ComponentType;
+  typedef typename TLabelImage::PixelType LabelType;
+
+  Clear();
+
+  const itk::ImageRegion<2> region = labelImage->GetLargestPossibleRegion();
+  const std::size_t numberOfPixels = region.GetNumberOfPixels();
+  if(numberOfPixels == 0)
+    {
+    return;
+    }
+
+  RegionStatisticsData<ComponentType, LabelType> data;
+  data.Image = image->GetBufferPointer();
+  data.Labels = labelImage->GetBufferPointer();
+  data.Width = region.GetSize()[0];
+  data.Height = region.GetSize()[1];
+  data.OriginX = region.GetIndex()[0];
+  data.OriginY = region.GetIndex()[1];
+  data.NumberOfComponents = image->GetNumberOfComponentsPerPixel();
+  data.Statistics = statistics | PixelCount;
+  data.HistogramBins = std::max(this->HistogramBins, 1u);
+  data.HistogramMinimum = this->HistogramMinimum;
+  // An empty (or reversed) range is widened to one unit, so that the scale stays finite.
+  const double histogramRange = this->HistogramMaximum > this->HistogramMinimum ?
+                                this->HistogramMaximum - this->HistogramMinimum : 1;
+  data.HistogramScale = data.HistogramBins / histogramRange;
+
+  if(numberOfLabels == 0)
+    {
+    numberOfLabels = static_cast<unsigned int>(*std::max_element(data.Labels, data.Labels + numberOfPixels)) + 1;
+    }
+
+  // The size of the sums of one run per label, to keep the sums of all runs within a few times the image.
+  const std::size_t components = data.NumberOfComponents;
+  RegionStatisticsAccumulator sizing;
+  sizing.Allocate(data.Statistics, 1, components, data.HistogramBins);
+  const std::size_t sumsPerLabel = sizing.PixelCounts.size() + sizing.ColorSums.size() + sizing.ColorProducts.size() +
+                                   sizing.XSums.size() + sizing.YSums.size() + 4 * sizing.MinimumX.size() +
+                                   sizing.Perimeters.size() + sizing.ColorHistograms.size();
+
+  // Runs of at least 64K pixels.
+  const std::size_t minimumRunSize = 65536;
+  std::size_t numberOfRuns = std::min<std::size_t>(itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                                   numberOfPixels / minimumRunSize);
+  numberOfRuns = std::min<std::size_t>(numberOfRuns, numberOfPixels * (components + 1) / (numberOfLabels * sumsPerLabel));
+  numberOfRuns = std::min<std::size_t>(numberOfRuns, data.Height);
+  data.NumberOfRuns = std::max<std::size_t>(1, numberOfRuns);
+  data.Runs.resize(data.NumberOfRuns);
+  for(unsigned int run = 0; run < data.NumberOfRuns; ++run)
+    {
+    data.Runs[run].Allocate(data.Statistics, numberOfLabels, components, data.HistogramBins);
+    }
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(data.NumberOfRuns);
+  threader->SetSingleMethod(RegionStatisticsData<ComponentType, LabelType>::ThreadFunction, &data);
+  threader->SingleMethodExecute();
+
+  RegionStatisticsAccumulator& sums = data.Runs[0];
+  for(unsigned int run = 1; run < data.NumberOfRuns; ++run)
+    {
+    sums.Merge(data.Runs[run]);
+    }
+
+  this->NumberOfLabels = numberOfLabels;
+  this->NumberOfComponents = data.NumberOfComponents;
+  this->Statistics = data.Statistics;
+  this->HistogramBins = data.HistogramBins;
+  this->PixelCounts.swap(sums.PixelCounts);
+
+  if(statistics & (MeanColor | ColorCovariance))
+    {
+    this->MeanColors.assign(numberOfLabels * components, 0);
+    for(std::size_t label = 0; label < numberOfLabels; ++label)
+      {
+      if(this->PixelCounts[label] == 0)
+        {
+        continue;
+        }
+      for(std::size_t component = 0; component < components; ++component)
+        {
+        this->MeanColors[label * components + component] =
+          sums.ColorSums[label * components + component] / this->PixelCounts[label];
+        }
+      }
+    }
+
+  if(statistics & ColorCovariance)
+    {
+    this->ColorCovariances.assign(numberOfLabels * components * components, 0);
+    for(std::size_t label = 0; label < numberOfLabels; ++label)
+      {
+      if(this->PixelCounts[label] == 0)
+        {
+        continue;
+        }
+      const double* mean = &this->MeanColors[label * components];
+      const double* products = &sums.ColorProducts[label * components * components];
+      double* covariance = &this->ColorCovariances[label * components * components];
+      for(std::size_t a = 0; a < components; ++a)
+        {
+        for(std::size_t b = a; b < components; ++b)
+          {
+          covariance[a * components + b] = products[a * components + b] / this->PixelCounts[label] - mean[a] * mean[b];
+          covariance[b * components + a] = covariance[a * components + b];
+          }
+        }
+      }
+    if(!(statistics & MeanColor))
+      {
+      this->MeanColors.clear();
+      }
+    }
+
+  if(statistics & Centroid)
+    {
+    this->CentroidsX.assign(numberOfLabels, 0);
+    this->CentroidsY.assign(numberOfLabels, 0);
+    for(std::size_t label = 0; label < numberOfLabels; ++label)
+      {
+      if(this->PixelCounts[label] > 0)
+        {
+        this->CentroidsX[label] = data.OriginX + sums.XSums[label] / this->PixelCounts[label];
+        this->CentroidsY[label] = data.OriginY + sums.YSums[label] / this->PixelCounts[label];
+        }
+      }
+    }
+
+  if(statistics & BoundingBox)
+    {
+    for(std::size_t label = 0; label < numberOfLabels; ++label)
+      {
+      if(this->PixelCounts[label] > 0)
+        {
+        sums.MinimumX[label] += data.OriginX;
+        sums.MaximumX[label] += data.OriginX;
+        sums.MinimumY[label] += data.OriginY;
+        sums.MaximumY[label] += data.OriginY;
+        }
+      }
+    this->MinimumX.swap(sums.MinimumX);
+    this->MinimumY.swap(sums.MinimumY);
+    this->MaximumX.swap(sums.MaximumX);
+    this->MaximumY.swap(sums.MaximumY);
+    }
+
+  if(statistics & Perimeter)
+    {
+    this->Perimeters.swap(sums.Perimeters);
+    }
+
+  if(statistics & ColorHistogram)
+    {
+    this->ColorHistograms.swap(sums.ColorHistograms);
+    }
+}
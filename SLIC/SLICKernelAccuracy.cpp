@@ -0,0 +1,157 @@
+// Compare the fixed point SLIC kernel against the double precision one on a set of images.
+// Usage: SLICKernelAccuracy NumberOfSuperPixels SpatialDistanceWeight image1 [image2 ...]
+
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkTimeProbe.h>
+#include <itkVectorImage.h>
+
+#include "SLICKernels.h"
+
+// STL
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+typedef itk::VectorImage<float, 2> ImageType;
+
+// Fraction of the boundary pixels of 'reference' that are also boundary pixels of 'labels'.
+// A pixel is a boundary pixel if its right or lower neighbor has a different label.
+static double BoundaryAgreement(const std::vector<int>& reference, const std::vector<int>& labels, const int width, const int height)
+{
+  unsigned int referenceBoundary = 0;
+  unsigned int sharedBoundary = 0;
+  for(int y = 0; y < height; ++y)
+    {
+    for(int x = 0; x < width; ++x)
+      {
+      const int i = y*width + x;
+      const bool isReferenceBoundary = (x + 1 < width && reference[i] != reference[i + 1]) ||
+                                       (y + 1 < height && reference[i] != reference[i + width]);
+      if(!isReferenceBoundary)
+        {
+        continue;
+        }
+      referenceBoundary++;
+      const bool isBoundary = (x + 1 < width && labels[i] != labels[i + 1]) ||
+                              (y + 1 < height && labels[i] != labels[i + width]);
+      if(isBoundary)
+        {
+        sharedBoundary++;
+        }
+      }
+    }
+  if(referenceBoundary == 0)
+    {
+    return 1.0;
+    }
+  return static_cast<double>(sharedBoundary)/static_cast<double>(referenceBoundary);
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 4)
+    {
+    std::cerr << "Required: NumberOfSuperPixels SpatialDistanceWeight image1 [image2 ...]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::stringstream ss;
+  ss << argv[1] << " " << argv[2];
+  int numberOfSuperPixels;
+  double spatialDistanceWeight;
+  ss >> numberOfSuperPixels >> spatialDistanceWeight;
+
+  std::cout << "Fixed point kernel instruction set: " << SLICKernelSegmentation::GetFixedPointInstructionSet() << std::endl;
+  std::cout << "image, assignment agreement, boundary agreement, labels (double), labels (fixed point), "
+            << "time (double) [s], time (fixed point) [s]" << std::endl;
+
+  double totalAssignmentAgreement = 0;
+  double totalBoundaryAgreement = 0;
+  double totalDoubleTime = 0;
+  double totalFixedPointTime = 0;
+
+  SLICKernelSegmentation segmentation;
+  const int numberOfImages = argc - 3;
+  for(int imageId = 0; imageId < numberOfImages; ++imageId)
+    {
+    typedef itk::ImageFileReader<ImageType> ReaderType;
+    ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(argv[3 + imageId]);
+    reader->Update();
+
+    const int width = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[0];
+    const int height = reader->GetOutput()->GetLargestPossibleRegion().GetSize()[1];
+
+    std::vector<unsigned int> packedImage(width*height);
+    itk::ImageRegionConstIterator<ImageType> imageIterator(reader->GetOutput(), reader->GetOutput()->GetLargestPossibleRegion());
+    unsigned int pixelId = 0;
+    while(!imageIterator.IsAtEnd())
+      {
+      const unsigned int r = static_cast<unsigned char>(imageIterator.Get()[0]);
+      const unsigned int g = static_cast<unsigned char>(imageIterator.Get()[1]);
+      const unsigned int b = static_cast<unsigned char>(imageIterator.Get()[2]);
+      packedImage[pixelId] = (1 << 24) | (r << 16) | (g << 8) | b;
+      ++imageIterator;
+      pixelId++;
+      }
+
+    segmentation.SetPackedRGBImage(&packedImage[0], width, height);
+
+    // Cluster assignment before the connectivity step: the cluster indices of both kernels refer to the same seeds.
+    std::vector<int> doubleAssignment(width*height);
+    std::vector<int> fixedPointAssignment(width*height);
+    segmentation.SetEnforceConnectivity(false);
+    segmentation.SetKernel(SLICKernelSegmentation::DoubleKernel);
+    segmentation.Segment(numberOfSuperPixels, spatialDistanceWeight, &doubleAssignment[0]);
+    segmentation.SetKernel(SLICKernelSegmentation::FixedPointKernel);
+    segmentation.Segment(numberOfSuperPixels, spatialDistanceWeight, &fixedPointAssignment[0]);
+
+    unsigned int agreeing = 0;
+    for(int i = 0; i < width*height; ++i)
+      {
+      if(doubleAssignment[i] == fixedPointAssignment[i])
+        {
+        agreeing++;
+        }
+      }
+    const double assignmentAgreement = static_cast<double>(agreeing)/static_cast<double>(width*height);
+
+    // Final superpixels
+    std::vector<int> doubleLabels(width*height);
+    std::vector<int> fixedPointLabels(width*height);
+    segmentation.SetEnforceConnectivity(true);
+
+    itk::TimeProbe doubleClock;
+    segmentation.SetKernel(SLICKernelSegmentation::DoubleKernel);
+    doubleClock.Start();
+    const int numberOfDoubleLabels = segmentation.Segment(numberOfSuperPixels, spatialDistanceWeight, &doubleLabels[0]);
+    doubleClock.Stop();
+
+    itk::TimeProbe fixedPointClock;
+    segmentation.SetKernel(SLICKernelSegmentation::FixedPointKernel);
+    fixedPointClock.Start();
+    const int numberOfFixedPointLabels = segmentation.Segment(numberOfSuperPixels, spatialDistanceWeight, &fixedPointLabels[0]);
+    fixedPointClock.Stop();
+
+    const double boundaryAgreement = BoundaryAgreement(doubleLabels, fixedPointLabels, width, height);
+
+    std::cout << argv[3 + imageId] << ", " << std::setprecision(6) << assignmentAgreement << ", " << boundaryAgreement << ", "
+              << numberOfDoubleLabels << ", " << numberOfFixedPointLabels << ", "
+              << doubleClock.GetTotal() << ", " << fixedPointClock.GetTotal() << std::endl;
+
+    totalAssignmentAgreement += assignmentAgreement;
+    totalBoundaryAgreement += boundaryAgreement;
+    totalDoubleTime += doubleClock.GetTotal();
+    totalFixedPointTime += fixedPointClock.GetTotal();
+    }
+
+  std::cout << "mean assignment agreement: " << totalAssignmentAgreement/numberOfImages << std::endl;
+  std::cout << "mean boundary agreement: " << totalBoundaryAgreement/numberOfImages << std::endl;
+  std::cout << "total time (double): " << totalDoubleTime << " s, total time (fixed point): " << totalFixedPointTime << " s" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,622 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "SLICKernels.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// The vector kernels are compiled with per-function target attributes and selected at run time,
+// so the rest of the library does not need to be built with -mavx2.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define SLIC_KERNELS_X86 1
+  #include <immintrin.h>
+#else
+  #define SLIC_KERNELS_X86 0
+#endif
+
+namespace
+{
+
+// Lab values are stored in 1/64 units. L is in [0,100] and a,b are within [-128,128], so the
+// quantized values and their differences fit in 16 bits and the sum of the three squared
+// differences (at most 6400^2 + 2*16384^2) fits in a signed 32 bit integer.
+const double LabScale = 64.0;
+const double LabScaleSquared = LabScale * LabScale;
+
+// The spatial terms are clamped so that color + row term + column term cannot overflow.
+const double MaximumSpatialTerm = 1 << 29;
+
+const int NumberOfIterations = 10;
+
+short QuantizeLab(const double value)
+{
+  double scaled = std::floor(value * LabScale + 0.5);
+  scaled = std::max(-16383.0, std::min(16383.0, scaled));
+  return static_cast<short>(scaled);
+}
+
+int QuantizeSpatialTerm(const double value)
+{
+  return static_cast<int>(std::min(MaximumSpatialTerm, std::floor(value * LabScaleSquared + 0.5)));
+}
+
+// sRGB to CIE Lab (D65), as in the reference SLIC implementation.
+void RGBToLab(const int sR, const int sG, const int sB, double& lval, double& aval, double& bval)
+{
+  double channels[3] = {sR/255.0, sG/255.0, sB/255.0};
+  for(unsigned int i = 0; i < 3; ++i)
+    {
+    if(channels[i] <= 0.04045)
+      {
+      channels[i] = channels[i]/12.92;
+      }
+    else
+      {
+      channels[i] = std::pow((channels[i] + 0.055)/1.055, 2.4);
+      }
+    }
+  const double r = channels[0];
+  const double g = channels[1];
+  const double b = channels[2];
+
+  const double X = r*0.4124564 + g*0.3575761 + b*0.1804375;
+  const double Y = r*0.2126729 + g*0.7151522 + b*0.0721750;
+  const double Z = r*0.0193339 + g*0.1191920 + b*0.9503041;
+
+  const double epsilon = 0.008856;
+  const double kappa = 903.3;
+
+  const double xr = X/0.950456;
+  const double yr = Y/1.0;
+  const double zr = Z/1.088754;
+
+  const double fx = (xr > epsilon) ? std::pow(xr, 1.0/3.0) : (kappa*xr + 16.0)/116.0;
+  const double fy = (yr > epsilon) ? std::pow(yr, 1.0/3.0) : (kappa*yr + 16.0)/116.0;
+  const double fz = (zr > epsilon) ? std::pow(zr, 1.0/3.0) : (kappa*zr + 16.0)/116.0;
+
+  lval = 116.0*fy - 16.0;
+  aval = 500.0*(fx - fy);
+  bval = 200.0*(fy - fz);
+}
+
+// Assign the pixels of one row segment to the cluster 'label' wherever the fixed point distance to
+// 'center' (L,a,b,0) is smaller than the current one. 'lab' holds 4 shorts per pixel.
+typedef void (*FixedPointRowKernel)(const short* lab, const int count, const short* center, const int rowTerm,
+                                    const int* columnTerms, const int label, int* distances, int* labels);
+
+void FixedPointRowScalar(const short* lab, const int count, const short* center, const int rowTerm,
+                         const int* columnTerms, const int label, int* distances, int* labels)
+{
+  for(int i = 0; i < count; ++i)
+    {
+    const int dl = lab[4*i] - center[0];
+    const int da = lab[4*i + 1] - center[1];
+    const int db = lab[4*i + 2] - center[2];
+    const int distance = dl*dl + da*da + db*db + rowTerm + columnTerms[i];
+    if(distance < distances[i])
+      {
+      distances[i] = distance;
+      labels[i] = label;
+      }
+    }
+}
+
+#if SLIC_KERNELS_X86
+
+__attribute__((target("sse4.1")))
+void FixedPointRowSSE41(const short* lab, const int count, const short* center, const int rowTerm,
+                        const int* columnTerms, const int label, int* distances, int* labels)
+{
+  long long packedCenter;
+  std::memcpy(&packedCenter, center, sizeof(packedCenter));
+  const __m128i centerVector = _mm_set1_epi64x(packedCenter);
+  const __m128i rowTermVector = _mm_set1_epi32(rowTerm);
+  const __m128i labelVector = _mm_set1_epi32(label);
+
+  // 4 pixels per iteration: each 128 bit load holds 2 pixels, madd gives (dl^2 + da^2, db^2) per pixel
+  // and hadd sums those pairs, leaving the 4 color distances in pixel order.
+  int i = 0;
+  for(; i + 4 <= count; i += 4)
+    {
+    const __m128i d0 = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lab + 4*i)), centerVector);
+    const __m128i d1 = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lab + 4*i + 8)), centerVector);
+    __m128i distance = _mm_hadd_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1));
+    distance = _mm_add_epi32(distance, _mm_add_epi32(rowTermVector,
+                                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(columnTerms + i))));
+
+    const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(distances + i));
+    const __m128i closer = _mm_cmpgt_epi32(current, distance);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + i), _mm_blendv_epi8(current, distance, closer));
+    const __m128i currentLabels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(labels + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(labels + i), _mm_blendv_epi8(currentLabels, labelVector, closer));
+    }
+
+  FixedPointRowScalar(lab + 4*i, count - i, center, rowTerm, columnTerms + i, label, distances + i, labels + i);
+}
+
+__attribute__((target("avx2")))
+void FixedPointRowAVX2(const short* lab, const int count, const short* center, const int rowTerm,
+                       const int* columnTerms, const int label, int* distances, int* labels)
+{
+  long long packedCenter;
+  std::memcpy(&packedCenter, center, sizeof(packedCenter));
+  const __m256i centerVector = _mm256_set1_epi64x(packedCenter);
+  const __m256i rowTermVector = _mm256_set1_epi32(rowTerm);
+  const __m256i labelVector = _mm256_set1_epi32(label);
+
+  // 8 pixels per iteration. hadd works within 128 bit lanes, so its result holds the pixels in the
+  // order 0,1,4,5,2,3,6,7; the 64 bit permute puts them back in order.
+  int i = 0;
+  for(; i + 8 <= count; i += 8)
+    {
+    const __m256i d0 = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lab + 4*i)), centerVector);
+    const __m256i d1 = _mm256_sub_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lab + 4*i + 16)), centerVector);
+    __m256i distance = _mm256_hadd_epi32(_mm256_madd_epi16(d0, d0), _mm256_madd_epi16(d1, d1));
+    distance = _mm256_permute4x64_epi64(distance, 0xD8);
+    distance = _mm256_add_epi32(distance, _mm256_add_epi32(rowTermVector,
+                                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columnTerms + i))));
+
+    const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distances + i));
+    const __m256i closer = _mm256_cmpgt_epi32(current, distance);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances + i), _mm256_blendv_epi8(current, distance, closer));
+    const __m256i currentLabels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(labels + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(labels + i), _mm256_blendv_epi8(currentLabels, labelVector, closer));
+    }
+
+  FixedPointRowScalar(lab + 4*i, count - i, center, rowTerm, columnTerms + i, label, distances + i, labels + i);
+}
+
+#endif
+
+struct FixedPointKernelChoice
+{
+  FixedPointRowKernel Kernel;
+  const char* Name;
+};
+
+FixedPointKernelChoice ChooseFixedPointKernel()
+{
+  FixedPointKernelChoice choice;
+  choice.Kernel = FixedPointRowScalar;
+  choice.Name = "scalar";
+#if SLIC_KERNELS_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    {
+    choice.Kernel = FixedPointRowAVX2;
+    choice.Name = "AVX2";
+    }
+  else if(__builtin_cpu_supports("sse4.1"))
+    {
+    choice.Kernel = FixedPointRowSSE41;
+    choice.Name = "SSE4.1";
+    }
+#endif
+  return choice;
+}
+
+// Chosen once, on first use; the initialization of a local static is thread safe, so filters may run on several
+// threads at once.
+const FixedPointKernelChoice& GetFixedPointKernelChoice()
+{
+  static const FixedPointKernelChoice choice = ChooseFixedPointKernel();
+  return choice;
+}
+
+} // end anonymous namespace
+
+SLICKernelSegmentation::SLICKernelSegmentation() : Kernel(DoubleKernel), EnforceConnectivityFlag(true), Width(0), Height(0)
+{
+
+}
+
+void SLICKernelSegmentation::SetKernel(const KernelType kernel)
+{
+  this->Kernel = kernel;
+}
+
+SLICKernelSegmentation::KernelType SLICKernelSegmentation::GetKernel() const
+{
+  return this->Kernel;
+}
+
+void SLICKernelSegmentation::SetEnforceConnectivity(const bool enforceConnectivity)
+{
+  this->EnforceConnectivityFlag = enforceConnectivity;
+}
+
+const char* SLICKernelSegmentation::GetFixedPointInstructionSet()
+{
+  return GetFixedPointKernelChoice().Name;
+}
+
+void SLICKernelSegmentation::SetPackedRGBImage(const unsigned int* packedRGB, const int width, const int height)
+{
+  this->Width = width;
+  this->Height = height;
+
+  const int numberOfPixels = width*height;
+  this->L.resize(numberOfPixels);
+  this->A.resize(numberOfPixels);
+  this->B.resize(numberOfPixels);
+
+  for(int i = 0; i < numberOfPixels; ++i)
+    {
+    const int r = (packedRGB[i] >> 16) & 0xFF;
+    const int g = (packedRGB[i] >> 8) & 0xFF;
+    const int b = packedRGB[i] & 0xFF;
+    RGBToLab(r, g, b, this->L[i], this->A[i], this->B[i]);
+    }
+}
+
+int SLICKernelSegmentation::Segment(const int numberOfSuperPixels, const double compactness, int* labels)
+{
+  const int numberOfPixels = this->Width*this->Height;
+
+  // Same step size, search window and spatial weight as the reference implementation.
+  const int step = static_cast<int>(std::sqrt(static_cast<double>(numberOfPixels)/static_cast<double>(numberOfSuperPixels)) + 2.0);
+  int offset = step;
+  if(step < 10)
+    {
+    offset = static_cast<int>(step*1.5);
+    }
+  const double spatialWeight = 1.0/((step/compactness)*(step/compactness));
+
+  InitializeCenters(step);
+
+  this->Assignment.assign(numberOfPixels, -1);
+
+  if(this->Kernel == FixedPointKernel)
+    {
+    this->QuantizedLab.resize(4*numberOfPixels);
+    for(int i = 0; i < numberOfPixels; ++i)
+      {
+      this->QuantizedLab[4*i] = QuantizeLab(this->L[i]);
+      this->QuantizedLab[4*i + 1] = QuantizeLab(this->A[i]);
+      this->QuantizedLab[4*i + 2] = QuantizeLab(this->B[i]);
+      this->QuantizedLab[4*i + 3] = 0;
+      }
+    }
+
+  for(int iteration = 0; iteration < NumberOfIterations; ++iteration)
+    {
+    if(this->Kernel == FixedPointKernel)
+      {
+      AssignFixedPoint(offset, spatialWeight);
+      }
+    else
+      {
+      AssignDouble(offset, spatialWeight);
+      }
+    UpdateCenters();
+    }
+
+  if(!this->EnforceConnectivityFlag)
+    {
+    std::copy(this->Assignment.begin(), this->Assignment.end(), labels);
+    return static_cast<int>(this->Centers.size());
+    }
+
+  return EnforceConnectivity(numberOfSuperPixels, labels);
+}
+
+void SLICKernelSegmentation::InitializeCenters(const int step)
+{
+  const int width = this->Width;
+  const int height = this->Height;
+
+  // Seeds on a regular grid, spreading the leftover pixels evenly between the strips.
+  int xstrips = static_cast<int>(0.5 + static_cast<double>(width)/static_cast<double>(step));
+  int ystrips = static_cast<int>(0.5 + static_cast<double>(height)/static_cast<double>(step));
+  xstrips = std::max(xstrips, 1);
+  ystrips = std::max(ystrips, 1);
+
+  int xerr = width - step*xstrips;
+  if(xerr < 0)
+    {
+    xstrips = std::max(xstrips - 1, 1);
+    xerr = width - step*xstrips;
+    }
+  int yerr = height - step*ystrips;
+  if(yerr < 0)
+    {
+    ystrips = std::max(ystrips - 1, 1);
+    yerr = height - step*ystrips;
+    }
+
+  const double xerrperstrip = static_cast<double>(xerr)/static_cast<double>(xstrips);
+  const double yerrperstrip = static_cast<double>(yerr)/static_cast<double>(ystrips);
+
+  const int xoff = step/2;
+  const int yoff = step/2;
+
+  this->Centers.clear();
+  for(int y = 0; y < ystrips; ++y)
+    {
+    const int ye = static_cast<int>(y*yerrperstrip);
+    for(int x = 0; x < xstrips; ++x)
+      {
+      const int xe = static_cast<int>(x*xerrperstrip);
+      int seedx = std::min(x*step + xoff + xe, width - 1);
+      int seedy = std::min(y*step + yoff + ye, height - 1);
+
+      // Move the seed to the lowest Lab gradient position in its 3x3 neighborhood.
+      const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
+      const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
+      double bestGradient = std::numeric_limits<double>::max();
+      int bestx = seedx;
+      int besty = seedy;
+      for(int n = -1; n < 8; ++n)
+        {
+        const int nx = (n < 0) ? seedx : seedx + dx8[n];
+        const int ny = (n < 0) ? seedy : seedy + dy8[n];
+        if(nx < 1 || nx >= width - 1 || ny < 1 || ny >= height - 1)
+          {
+          continue;
+          }
+        const int i = ny*width + nx;
+        const double gx = (this->L[i - 1] - this->L[i + 1])*(this->L[i - 1] - this->L[i + 1]) +
+                          (this->A[i - 1] - this->A[i + 1])*(this->A[i - 1] - this->A[i + 1]) +
+                          (this->B[i - 1] - this->B[i + 1])*(this->B[i - 1] - this->B[i + 1]);
+        const double gy = (this->L[i - width] - this->L[i + width])*(this->L[i - width] - this->L[i + width]) +
+                          (this->A[i - width] - this->A[i + width])*(this->A[i - width] - this->A[i + width]) +
+                          (this->B[i - width] - this->B[i + width])*(this->B[i - width] - this->B[i + width]);
+        if(gx + gy < bestGradient)
+          {
+          bestGradient = gx + gy;
+          bestx = nx;
+          besty = ny;
+          }
+        }
+      seedx = bestx;
+      seedy = besty;
+
+      const int i = seedy*width + seedx;
+      Center center;
+      center.L = this->L[i];
+      center.A = this->A[i];
+      center.B = this->B[i];
+      center.X = seedx;
+      center.Y = seedy;
+      this->Centers.push_back(center);
+      }
+    }
+}
+
+void SLICKernelSegmentation::AssignDouble(const int offset, const double spatialWeight)
+{
+  const int width = this->Width;
+  const int height = this->Height;
+
+  this->Distances.assign(width*height, std::numeric_limits<double>::max());
+
+  for(unsigned int n = 0; n < this->Centers.size(); ++n)
+    {
+    const Center& center = this->Centers[n];
+    const int y1 = static_cast<int>(std::max(0.0, center.Y - offset));
+    const int y2 = static_cast<int>(std::min(static_cast<double>(height), center.Y + offset));
+    const int x1 = static_cast<int>(std::max(0.0, center.X - offset));
+    const int x2 = static_cast<int>(std::min(static_cast<double>(width), center.X + offset));
+
+    for(int y = y1; y < y2; ++y)
+      {
+      for(int x = x1; x < x2; ++x)
+        {
+        const int i = y*width + x;
+        const double colorDistance = (this->L[i] - center.L)*(this->L[i] - center.L) +
+                                     (this->A[i] - center.A)*(this->A[i] - center.A) +
+                                     (this->B[i] - center.B)*(this->B[i] - center.B);
+        const double spatialDistance = (x - center.X)*(x - center.X) + (y - center.Y)*(y - center.Y);
+        const double distance = colorDistance + spatialDistance*spatialWeight;
+        if(distance < this->Distances[i])
+          {
+          this->Distances[i] = distance;
+          this->Assignment[i] = n;
+          }
+        }
+      }
+    }
+}
+
+void SLICKernelSegmentation::AssignFixedPoint(const int offset, const double spatialWeight)
+{
+  const int width = this->Width;
+  const int height = this->Height;
+
+  this->FixedPointDistances.assign(width*height, std::numeric_limits<int>::max());
+  this->ColumnTerms.resize(2*offset + 1);
+
+  const FixedPointRowKernel rowKernel = GetFixedPointKernelChoice().Kernel;
+
+  for(unsigned int n = 0; n < this->Centers.size(); ++n)
+    {
+    const Center& center = this->Centers[n];
+    const int y1 = static_cast<int>(std::max(0.0, center.Y - offset));
+    const int y2 = static_cast<int>(std::min(static_cast<double>(height), center.Y + offset));
+    const int x1 = static_cast<int>(std::max(0.0, center.X - offset));
+    const int x2 = static_cast<int>(std::min(static_cast<double>(width), center.X + offset));
+    if(x2 <= x1)
+      {
+      continue;
+      }
+
+    const short quantizedCenter[4] = {QuantizeLab(center.L), QuantizeLab(center.A), QuantizeLab(center.B), 0};
+
+    // The spatial term separates into a row part and a column part; both are computed once per
+    // window in double precision and rounded, so the kernel only adds integers.
+    for(int x = x1; x < x2; ++x)
+      {
+      this->ColumnTerms[x - x1] = QuantizeSpatialTerm((x - center.X)*(x - center.X)*spatialWeight);
+      }
+
+    for(int y = y1; y < y2; ++y)
+      {
+      const int rowTerm = QuantizeSpatialTerm((y - center.Y)*(y - center.Y)*spatialWeight);
+      const int i = y*width + x1;
+      rowKernel(&this->QuantizedLab[4*i], x2 - x1, quantizedCenter, rowTerm, &this->ColumnTerms[0], n,
+                &this->FixedPointDistances[i], &this->Assignment[i]);
+      }
+    }
+}
+
+void SLICKernelSegmentation::UpdateCenters()
+{
+  const int width = this->Width;
+  const int height = this->Height;
+  const unsigned int numberOfCenters = this->Centers.size();
+
+  this->Sums.assign(5*numberOfCenters, 0.0);
+  this->Counts.assign(numberOfCenters, 0);
+
+  for(int y = 0; y < height; ++y)
+    {
+    for(int x = 0; x < width; ++x)
+      {
+      const int i = y*width + x;
+      const int label = this->Assignment[i];
+      if(label < 0)
+        {
+        continue;
+        }
+      double* sum = &this->Sums[5*label];
+      sum[0] += this->L[i];
+      sum[1] += this->A[i];
+      sum[2] += this->B[i];
+      sum[3] += x;
+      sum[4] += y;
+      this->Counts[label]++;
+      }
+    }
+
+  for(unsigned int n = 0; n < numberOfCenters; ++n)
+    {
+    if(this->Counts[n] <= 0)
+      {
+      this->Counts[n] = 1;
+      }
+    const double inverse = 1.0/this->Counts[n];
+    const double* sum = &this->Sums[5*n];
+    this->Centers[n].L = sum[0]*inverse;
+    this->Centers[n].A = sum[1]*inverse;
+    this->Centers[n].B = sum[2]*inverse;
+    this->Centers[n].X = sum[3]*inverse;
+    this->Centers[n].Y = sum[4]*inverse;
+    }
+}
+
+int SLICKernelSegmentation::EnforceConnectivity(const int numberOfSuperPixels, int* labels)
+{
+  const int width = this->Width;
+  const int height = this->Height;
+  const int numberOfPixels = width*height;
+  const int superPixelSize = numberOfPixels/numberOfSuperPixels;
+
+  const int dx4[4] = {-1,  0,  1,  0};
+  const int dy4[4] = { 0, -1,  0,  1};
+
+  std::fill(labels, labels + numberOfPixels, -1);
+  this->SegmentX.resize(numberOfPixels);
+  this->SegmentY.resize(numberOfPixels);
+
+  // Label the 4-connected components of the assignment; components smaller than a quarter of the
+  // expected superpixel size are merged into the component that was labeled before them.
+  int label = 0;
+  int adjacentLabel = 0;
+  int oindex = 0;
+  for(int j = 0; j < height; ++j)
+    {
+    for(int k = 0; k < width; ++k)
+      {
+      if(labels[oindex] < 0)
+        {
+        labels[oindex] = label;
+        this->SegmentX[0] = k;
+        this->SegmentY[0] = j;
+
+        for(int n = 0; n < 4; ++n)
+          {
+          const int x = k + dx4[n];
+          const int y = j + dy4[n];
+          if((x >= 0 && x < width) && (y >= 0 && y < height))
+            {
+            const int nindex = y*width + x;
+            if(labels[nindex] >= 0)
+              {
+              adjacentLabel = labels[nindex];
+              }
+            }
+          }
+
+        int count = 1;
+        for(int c = 0; c < count; ++c)
+          {
+          for(int n = 0; n < 4; ++n)
+            {
+            const int x = this->SegmentX[c] + dx4[n];
+            const int y = this->SegmentY[c] + dy4[n];
+            if((x >= 0 && x < width) && (y >= 0 && y < height))
+              {
+              const int nindex = y*width + x;
+              if(labels[nindex] < 0 && this->Assignment[oindex] == this->Assignment[nindex])
+                {
+                this->SegmentX[count] = x;
+                this->SegmentY[count] = y;
+                labels[nindex] = label;
+                count++;
+                }
+              }
+            }
+          }
+
+        if(count <= superPixelSize >> 2)
+          {
+          for(int c = 0; c < count; ++c)
+            {
+            labels[this->SegmentY[c]*width + this->SegmentX[c]] = adjacentLabel;
+            }
+          label--;
+          }
+        label++;
+        }
+      oindex++;
+      }
+    }
+
+  return label;
+}
+
+void SLICKernelSegmentation::Release()
+{
+  std::vector<double>().swap(this->L);
+  std::vector<double>().swap(this->A);
+  std::vector<double>().swap(this->B);
+  std::vector<short>().swap(this->QuantizedLab);
+  std::vector<Center>().swap(this->Centers);
+  std::vector<int>().swap(this->Assignment);
+  std::vector<double>().swap(this->Distances);
+  std::vector<int>().swap(this->FixedPointDistances);
+  std::vector<int>().swap(this->ColumnTerms);
+  std::vector<double>().swap(this->Sums);
+  std::vector<int>().swap(this->Counts);
+  std::vector<int>().swap(this->SegmentX);
+  std::vector<int>().swap(this->SegmentY);
+}
@@ -0,0 +1,101 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef SLICKERNELS_H
+#define SLICKERNELS_H
+
+// STL
+#include <vector>
+
+// SLIC superpixels (Achanta et al.) with a choice of distance kernel for the assignment step.
+//
+// DoubleKernel computes the Lab color distance and the spatial distance in double precision, like the
+// reference SLIC implementation. FixedPointKernel quantizes Lab to 16 bit integers (1/64 units) and
+// computes the combined distance in 32 bit integer arithmetic, using AVX2 or SSE4.1 when the CPU has them.
+// Both kernels are driven by the same seeding, center update and connectivity code, so their results can
+// be compared directly (see SLICKernelAccuracy.cpp).
+class SLICKernelSegmentation
+{
+public:
+  enum KernelType { DoubleKernel, FixedPointKernel };
+
+  SLICKernelSegmentation();
+
+  void SetKernel(const KernelType kernel);
+  KernelType GetKernel() const;
+
+  // Merge small disconnected fragments into their neighbors (on by default). When off, Segment()
+  // returns the raw assignment, i.e. the index of the cluster each pixel belongs to.
+  void SetEnforceConnectivity(const bool enforceConnectivity);
+
+  // Set the image from RGB values packed as 0xXXRRGGBB (the format itkSLICSegmentation builds), row major.
+  void SetPackedRGBImage(const unsigned int* packedRGB, const int width, const int height);
+
+  // Compute approximately numberOfSuperPixels superpixels and write one label per pixel. Returns the number of labels.
+  int Segment(const int numberOfSuperPixels, const double compactness, int* labels);
+
+  // Name of the instruction set FixedPointKernel uses on this CPU ("AVX2", "SSE4.1" or "scalar").
+  static const char* GetFixedPointInstructionSet();
+
+  // Free the buffers that are kept between calls.
+  void Release();
+
+private:
+  struct Center
+  {
+    double L;
+    double A;
+    double B;
+    double X;
+    double Y;
+  };
+
+  void InitializeCenters(const int step);
+  void AssignDouble(const int offset, const double spatialWeight);
+  void AssignFixedPoint(const int offset, const double spatialWeight);
+  void UpdateCenters();
+  int EnforceConnectivity(const int numberOfSuperPixels, int* labels);
+
+  KernelType Kernel;
+  bool EnforceConnectivityFlag;
+
+  int Width;
+  int Height;
+
+  // Lab planes
+  std::vector<double> L;
+  std::vector<double> A;
+  std::vector<double> B;
+
+  // Lab quantized to 1/64 units, interleaved as L,a,b,0 per pixel (only used by FixedPointKernel)
+  std::vector<short> QuantizedLab;
+
+  std::vector<Center> Centers;
+  std::vector<int> Assignment;
+  std::vector<double> Distances;
+  std::vector<int> FixedPointDistances;
+  std::vector<int> ColumnTerms;
+
+  // Used by UpdateCenters() and EnforceConnectivity()
+  std::vector<double> Sums;
+  std::vector<int> Counts;
+  std::vector<int> SegmentX;
+  std::vector<int> SegmentY;
+};
+
+#endif
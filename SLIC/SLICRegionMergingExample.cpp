@@ -0,0 +1,63 @@
+#include <itkImage.h>
+#include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+
+#include "itkSLICSegmentation.h"
+#include "RegionAdjacencyGraph.h"
+#include "RegionMerging.h"
+
+#include <cstdlib>
+#include <iostream>
+
+typedef itk::VectorImage<float, 2> ImageType;
+typedef itk::Image<int, 2> LabelImageType;
+
+// Segment an image into superpixels with SLIC, then merge the superpixels with the closest mean colors until the
+// requested number of regions is left.
+int main(int argc, char* argv[])
+{
+  if(argc < 3)
+    {
+    std::cerr << "Required arguments: input output [numberOfRegions]" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const unsigned int numberOfRegions = argc > 3 ? atoi(argv[3]) : 20;
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(argv[1]);
+  reader->Update();
+
+  // The mean colors of the superpixels are computed along with them.
+  typedef itk::SLICSegmentation<ImageType, LabelImageType> SLICSegmentationType;
+  SLICSegmentationType::Pointer slicSegmentation = SLICSegmentationType::New();
+  slicSegmentation->SetNumberOfSuperPixels(200);
+  slicSegmentation->SetSpatialDistanceWeight(5.0);
+  slicSegmentation->SetStatistics(RegionStatistics::MeanColor);
+  slicSegmentation->SetInput(reader->GetOutput());
+  slicSegmentation->Update();
+
+  const RegionStatistics& statistics = slicSegmentation->GetRegionStatistics()->Get();
+
+  RegionAdjacencyGraph graph;
+  graph.Build(reader->GetOutput(), slicSegmentation->GetLabelImage(), statistics.NumberOfLabels);
+  std::cout << graph.NumberOfRegions << " superpixels, " << graph.GetNumberOfEdges() << " pairs touch." << std::endl;
+
+  RegionMerging merging;
+  if(!merging.Merge(graph, statistics, numberOfRegions))
+    {
+    return EXIT_FAILURE;
+    }
+  std::cout << merging.FinalNumberOfRegions << " regions after " << merging.MergeCosts.size() << " merges." << std::endl;
+
+  LabelImageType::Pointer mergedLabels = LabelImageType::New();
+  merging.Relabel(slicSegmentation->GetLabelImage(), mergedLabels.GetPointer());
+
+  typedef itk::ImageFileWriter<LabelImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName(argv[2]);
+  writer->SetInput(mergedLabels);
+  writer->Update();
+
+  return EXIT_SUCCESS;
+}
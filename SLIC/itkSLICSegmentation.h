@@ -3,6 +3,15 @@
 #define __itkSLICSegmentation_h
 
 #include "itkImageToImageFilter.h"
+#include "itkSimpleDataObjectDecorator.h"
+
+// Custom
+#include "DebugImageWriter.h"
+#include "RegionStatistics.h"
+#include "ScratchBuffer.h"
+
+// SLIC
+#include "SLICKernels.h"
 
 namespace itk
 {
@@ -15,6 +24,9 @@ public:
   typedef ImageToImageFilter<TInputImage, TOutputLabelImage> Superclass;
   typedef SmartPointer< Self >        Pointer;
 
+  /** The output holding the statistics of each superpixel. */
+  typedef SimpleDataObjectDecorator< ::RegionStatistics > RegionStatisticsObjectType;
+
   /** Method for creation through the object factory. */
   itkNewMacro(Self);
 
@@ -29,9 +41,32 @@ public:
   itkSetMacro( SpatialDistanceWeight, float );
   itkGetMacro( SpatialDistanceWeight, float);
 
+  // Use the 16 bit fixed point distance kernel (SLICKernels.h) instead of the reference SLIC implementation.
+  // Off by default; SLICKernelAccuracy reports how much the results differ on a set of images.
+  itkSetMacro( UseFixedPointKernel, bool);
+  itkGetMacro( UseFixedPointKernel, bool);
+  itkBooleanMacro( UseFixedPointKernel);
+
+  // The statistics of each superpixel to compute into GetRegionStatistics(), as an or of RegionStatistics::Statistic.
+  // 0 (the default) computes none. The histogram settings of the RegionStatistics of the output are kept.
+  itkSetMacro( Statistics, unsigned int);
+  itkGetMacro( Statistics, unsigned int);
+
+  // Write intermediate images to DebugDirectory on a background thread. Off by default.
+  itkSetMacro( WriteDebugImages, bool);
+  itkGetMacro( WriteDebugImages, bool);
+
+  // Directory the debug images are written to.
+  itkSetStringMacro( DebugDirectory );
+  itkGetStringMacro( DebugDirectory );
+
   TOutputLabelImage* GetLabelImage();
   TInputImage* GetContourImage();
   TInputImage* GetColoredImage();
+  RegionStatisticsObjectType* GetRegionStatistics();
+
+  // Free the scratch buffers that are kept between updates.
+  void ReleaseWorkspace();
   
 protected:
   SLICSegmentation();
@@ -48,7 +83,7 @@ private:
   // This function takes 4 unsigned chars and inserts them into an int (4x8bit = 32bit)
   // For an RGB pixel, use:
   // int intPixel = PACK(1, R, G, B);
-  inline int PACK(const char c0, const char c1, const char c2, const char c3) 
+  inline int PACK(const unsigned char c0, const unsigned char c1, const unsigned char c2, const unsigned char c3)
   {
     return (c0 << 24) | (c1 << 16) | (c2 << 8) | c3;
   }
@@ -58,8 +93,23 @@ private:
 
   int m_NumberOfSuperPixels;
   float m_SpatialDistanceWeight;
-  
-  int* Labels;
+  bool m_UseFixedPointKernel;
+
+  unsigned int m_Statistics;
+
+  bool m_WriteDebugImages;
+  std::string m_DebugDirectory;
+  DebugImageWriter m_DebugImageWriter;
+
+  // Scratch buffers that are reused by every update on same-sized inputs.
+  struct Workspace
+  {
+    ScratchBuffer<unsigned int> PackedImage; // RGB values packed into ints, as the SLIC implementation expects
+    ScratchBuffer<int> Labels; // Labels produced by the SLIC implementation
+    ScratchBuffer<bool> ContourTaken; // Pixels already marked as contour pixels
+    SLICKernelSegmentation KernelSegmentation; // Lab image and cluster buffers of the fixed point kernel
+  };
+  Workspace m_Workspace;
 };
 } //namespace ITK
 
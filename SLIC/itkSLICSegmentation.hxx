@@ -16,18 +16,22 @@
 // Segmentation
 #include "SLIC.h"
 
+// STL
+#include <algorithm>
+
 namespace itk
 {
 
 template< typename TInputImage, typename TOutputLabelImage>
 SLICSegmentation< TInputImage, TOutputLabelImage>
-::SLICSegmentation() : m_NumberOfSuperPixels(200), m_SpatialDistanceWeight(5.0)
+::SLICSegmentation() : m_NumberOfSuperPixels(200), m_SpatialDistanceWeight(5.0), m_UseFixedPointKernel(false), m_Statistics(0), m_WriteDebugImages(false), m_DebugDirectory(".")
 {
-  this->SetNumberOfRequiredOutputs(3);
+  this->SetNumberOfRequiredOutputs(4);
 
   this->SetNthOutput( 0, this->MakeOutput(0) );
   this->SetNthOutput( 1, this->MakeOutput(1) );
   this->SetNthOutput( 2, this->MakeOutput(2) );
+  this->SetNthOutput( 3, this->MakeOutput(3) );
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
@@ -46,6 +50,9 @@ DataObject::Pointer SLICSegmentation<TInputImage, TOutputLabelImage>::MakeOutput
     case 2:
       output = ( TInputImage::New() ).GetPointer(); // The output for the image with the segment boundaries drawn on it
       break;
+    case 3:
+      output = ( RegionStatisticsObjectType::New() ).GetPointer(); // The output for the statistics of each region
+      break;
     default:
       std::cerr << "No output " << idx << std::endl;
       output = NULL;
@@ -72,43 +79,65 @@ TInputImage* SLICSegmentation<TInputImage, TOutputLabelImage>::GetColoredImage()
   return dynamic_cast< TInputImage * >(this->ProcessObject::GetOutput(2) );
 }
 
+template< typename TInputImage, typename TOutputLabelImage>
+typename SLICSegmentation<TInputImage, TOutputLabelImage>::RegionStatisticsObjectType*
+SLICSegmentation<TInputImage, TOutputLabelImage>::GetRegionStatistics()
+{
+  return dynamic_cast< RegionStatisticsObjectType * >(this->ProcessObject::GetOutput(3) );
+}
+
+template< typename TInputImage, typename TOutputLabelImage>
+void SLICSegmentation< TInputImage, TOutputLabelImage>
+::ReleaseWorkspace()
+{
+  this->m_Workspace.PackedImage.Release();
+  this->m_Workspace.Labels.Release();
+  this->m_Workspace.ContourTaken.Release();
+  this->m_Workspace.KernelSegmentation.Release();
+}
+
 template< typename TInputImage, typename TOutputLabelImage>
 void SLICSegmentation< TInputImage, TOutputLabelImage>
 ::GenerateData()
 {
   TInputImage* input = const_cast<TInputImage*>(this->GetInput());
 
+  unsigned int width = input->GetLargestPossibleRegion().GetSize()[0];
+  unsigned int height = input->GetLargestPossibleRegion().GetSize()[1];
+
+  int numberOfPixels = width*height;
+
   // The SLIC implementation expects RGB values packed into int pixels.
-  typedef itk::Image<unsigned int, 2> UnsignedIntImageType;
-  UnsignedIntImageType::Pointer image = UnsignedIntImageType::New();
-  image->SetRegions(input->GetLargestPossibleRegion());
-  image->Allocate();
+  unsigned int* packedImage = this->m_Workspace.PackedImage.Reserve(numberOfPixels);
 
   itk::ImageRegionIterator<TInputImage> imageIterator(input, input->GetLargestPossibleRegion());
 
+  unsigned int pixelId = 0;
   while(!imageIterator.IsAtEnd())
     {
-    int intPixel = PACK(1, imageIterator.Get()[0], imageIterator.Get()[1], imageIterator.Get()[2]);
-    image->SetPixel(imageIterator.GetIndex(), intPixel);
+    packedImage[pixelId] = PACK(1, imageIterator.Get()[0], imageIterator.Get()[1], imageIterator.Get()[2]);
  
     ++imageIterator;
+    pixelId++;
     }
 
-  //WriteImage<UnsignedIntImageType>(image, "input4channel.mha");
-
-  unsigned int width = image->GetLargestPossibleRegion().GetSize()[0];
-  unsigned int height = image->GetLargestPossibleRegion().GetSize()[1];
-
-  int numberOfPixels = width*height;
-
-  this->Labels = new int[numberOfPixels];
+  int* labels = this->m_Workspace.Labels.Reserve(numberOfPixels);
   int numlabels(0);
-  SLIC slic;
-  
-  slic.DoSuperpixelSegmentation_ForGivenK(image->GetBufferPointer(), width, height, this->Labels, numlabels, m_NumberOfSuperPixels, m_SpatialDistanceWeight);
+  if(this->m_UseFixedPointKernel)
+    {
+    SLICKernelSegmentation& kernelSegmentation = this->m_Workspace.KernelSegmentation;
+    kernelSegmentation.SetKernel(SLICKernelSegmentation::FixedPointKernel);
+    kernelSegmentation.SetPackedRGBImage(packedImage, width, height);
+    numlabels = kernelSegmentation.Segment(m_NumberOfSuperPixels, m_SpatialDistanceWeight, labels);
+    }
+  else
+    {
+    SLIC slic;
+    slic.DoSuperpixelSegmentation_ForGivenK(packedImage, width, height, labels, numlabels, m_NumberOfSuperPixels, m_SpatialDistanceWeight);
+    }
   
   typename TOutputLabelImage::Pointer outputLabelImage = this->GetLabelImage(); // One of the output ports
-  outputLabelImage->SetRegions(image->GetLargestPossibleRegion());
+  outputLabelImage->SetRegions(input->GetLargestPossibleRegion());
   outputLabelImage->Allocate();
   
   itk::ImageRegionIterator<TOutputLabelImage> labelIterator(outputLabelImage, outputLabelImage->GetLargestPossibleRegion());
@@ -116,15 +145,18 @@ void SLICSegmentation< TInputImage, TOutputLabelImage>
   unsigned int labelId = 0;
   while(!labelIterator.IsAtEnd())
     {
-    labelIterator.Set(this->Labels[labelId]);
+    labelIterator.Set(labels[labelId]);
  
     ++labelIterator;
     labelId++;
     }
 
-  Helpers::RelabelSequential<TOutputLabelImage>(outputLabelImage, outputLabelImage); // This is the 0th output port of the filter
+  const unsigned int numberOfLabels = Helpers::RelabelSequential<TOutputLabelImage>(outputLabelImage, outputLabelImage); // This is the 0th output port of the filter
   
-  Helpers::WriteImage<TOutputLabelImage>(outputLabelImage, "SLIC_LabelImage.mha");
+  if(this->m_WriteDebugImages)
+    {
+    this->m_DebugImageWriter.Write<TOutputLabelImage>(outputLabelImage, this->m_DebugDirectory, "SLIC_LabelImage.mha");
+    }
   
   typename TInputImage::PixelType contourColor;
   contourColor.SetSize(3);
@@ -134,8 +166,22 @@ void SLICSegmentation< TInputImage, TOutputLabelImage>
   
   DrawContoursAroundSegments(contourColor);
   
-  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(input, this->GetLabelImage(), this->GetColoredImage());
-  Helpers::WriteImage<TInputImage>(this->GetColoredImage(), "SLIC_ColoredImage.mha");
+  Helpers::ColorLabelsByAverageColor<TInputImage, TOutputLabelImage>(input, this->GetLabelImage(), this->GetColoredImage(), numberOfLabels);
+  if(this->m_WriteDebugImages)
+    {
+    this->m_DebugImageWriter.Write<TInputImage>(this->GetColoredImage(), this->m_DebugDirectory, "SLIC_ColoredImage.mha");
+    }
+
+  // The statistics, or an empty table so that none of a previous update is left.
+  if(this->m_Statistics)
+    {
+    this->GetRegionStatistics()->Get().Compute(input, this->GetLabelImage(), this->m_Statistics, numberOfLabels);
+    }
+  else
+    {
+    this->GetRegionStatistics()->Get().Clear();
+    }
+  this->GetRegionStatistics()->Modified();
 }
 
 template< typename TInputImage, typename TOutputLabelImage>
@@ -152,7 +198,10 @@ void SLICSegmentation< TInputImage, TOutputLabelImage>
   unsigned int height = this->GetContourImage()->GetLargestPossibleRegion().GetSize()[1];
   unsigned int sz = width*height;
 
-  std::vector<bool> istaken(sz, false);
+  const int* labels = this->m_Workspace.Labels.GetPointer();
+
+  bool* istaken = this->m_Workspace.ContourTaken.Reserve(sz);
+  std::fill(istaken, istaken + sz, false);
 
   int mainindex(0);
   for( int j = 0; j < height; j++ )
@@ -171,7 +220,7 @@ void SLICSegmentation< TInputImage, TOutputLabelImage>
 
           if( false == istaken[index] )//comment this to obtain internal contours
           {
-            if( this->Labels[mainindex] != this->Labels[index] ) np++;
+            if( labels[mainindex] != labels[index] ) np++;
           }
         }
       }
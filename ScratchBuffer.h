@@ -0,0 +1,76 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2011 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef SCRATCHBUFFER_H
+#define SCRATCHBUFFER_H
+
+// STL
+#include <cstddef>
+
+// A heap array that is kept alive between filter updates. Reserve() only goes back to the
+// allocator when more elements are requested than are already held, so repeated runs on
+// same-sized inputs reuse the memory (and the already faulted-in pages) of the first run.
+template <typename T>
+class ScratchBuffer
+{
+public:
+  ScratchBuffer() : Data(NULL), Capacity(0) {}
+  ~ScratchBuffer()
+  {
+    Release();
+  }
+
+  // Make sure the buffer holds at least 'size' elements and return it. The contents are not initialized.
+  T* Reserve(const std::size_t size)
+  {
+    if(size > this->Capacity)
+      {
+      delete [] this->Data;
+      this->Data = new T[size];
+      this->Capacity = size;
+      }
+    return this->Data;
+  }
+
+  T* GetPointer()
+  {
+    return this->Data;
+  }
+
+  std::size_t GetCapacity() const
+  {
+    return this->Capacity;
+  }
+
+  // Give the memory back to the allocator.
+  void Release()
+  {
+    delete [] this->Data;
+    this->Data = NULL;
+    this->Capacity = 0;
+  }
+
+private:
+  ScratchBuffer(const ScratchBuffer&); //purposely not implemented
+  void operator=(const ScratchBuffer&); //purposely not implemented
+
+  T* Data;
+  std::size_t Capacity;
+};
+
+#endif